@@ -0,0 +1,212 @@
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <string>
+#include "tablebase.h"
+#include "board.h"
+#include "index.h"
+#include "movegen.h"
+#include "indexing.h"
+#include "perft.h"
+
+// Microbenchmarks of the basic operations used when generating the database.
+// The results are written to standard output as JSON.
+//
+// Each benchmark runs over all legal positions of the 4x4 board, and is
+// repeated until it has run for at least cMinSeconds.
+
+typedef Board<4, 4> BoardType;
+
+const double cMinSeconds = 0.25;
+
+// Results are accumulated here, so the compiler can not remove the work.
+static volatile uint64_t g_sink;
+
+static bool g_first = true;
+
+// Time func, which performs numOps operations per call, and write the result
+// as a JSON object.
+template <typename Func>
+static void benchmark(const char *name, uint64_t numOps, Func func)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    uint64_t checksum = 0;
+    uint64_t totalOps = 0;
+    Clock::time_point start = Clock::now();
+    double seconds = 0;
+    while (seconds < cMinSeconds) {
+        checksum += func();
+        totalOps += numOps;
+        seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    }
+    g_sink = checksum;
+
+    std::cout << (g_first ? "" : ",") << std::endl;
+    std::cout << "    {\"name\": \"" << name << "\", "
+        << "\"ops\": " << totalOps << ", "
+        << "\"seconds\": " << seconds << ", "
+        << "\"ns_per_op\": " << seconds * 1e9 / totalOps << "}";
+    g_first = false;
+} // benchmark
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        std::cerr << "Usage: touchdown_bench db_file_name" << std::endl;
+        return 1;
+    }
+
+    indexInit();
+
+    // Collect all legal positions.
+    std::vector<uint32_t> indices;
+    std::vector<BoardType::Position> positions;
+    SparseIndex<4, 4>::forEachValid(0, 0x01000000, [&](uint64_t index) {
+        BoardType board((uint32_t) index);
+        if (!board.isWin()) {
+            indices.push_back(index);
+            positions.push_back(board.getPosition());
+        }
+    });
+    const uint64_t numPositions = positions.size();
+
+    TableBase tb(argv[1], g_numPositions, TableBase::ReadOnly);
+
+    std::cout << "{" << std::endl;
+    std::cout << "  \"board\": \"4x4\"," << std::endl;
+    std::cout << "  \"positions\": " << numPositions << "," << std::endl;
+    std::cout << "  \"bmi2\": " << (indexUseBmi2 ? "true" : "false") << "," << std::endl;
+    std::cout << "  \"movegen\": \"" << movegenName() << "\"," << std::endl;
+    std::cout << "  \"benchmarks\": [";
+
+    benchmark("indexIsValid", 0x01000000, [&]() {
+        uint64_t count = 0;
+        for (uint32_t index = 0; index < 0x01000000; ++index) {
+            count += indexIsValid(index);
+        }
+        return count;
+    });
+
+    benchmark("SparseIndex::forEachValid", 0x01000000, [&]() {
+        uint64_t count = 0;
+        SparseIndex<4, 4>::forEachValid(0, 0x01000000, [&](uint64_t index) {
+            count += index;
+        });
+        return count;
+    });
+
+    benchmark("Board(index)", numPositions, [&]() {
+        uint64_t sum = 0;
+        for (uint32_t index : indices) {
+            sum += BoardType(index).getPosition();
+        }
+        return sum;
+    });
+
+    benchmark("getIndex", numPositions, [&]() {
+        uint64_t sum = 0;
+        BoardType board;
+        for (BoardType::Position position : positions) {
+            board.setPosition(position);
+            sum += board.getIndex();
+        }
+        return sum;
+    });
+
+    benchmark("getRank", numPositions, [&]() {
+        uint64_t sum = 0;
+        BoardType board;
+        for (BoardType::Position position : positions) {
+            board.setPosition(position);
+            sum += board.getRank();
+        }
+        return sum;
+    });
+
+    benchmark("fromRank", numPositions, [&]() {
+        uint64_t sum = 0;
+        for (uint64_t rank = 0; rank < numPositions; ++rank) {
+            sum += BoardType::fromRank(rank).getPosition();
+        }
+        return sum;
+    });
+
+    benchmark("swapPosition", numPositions, [&]() {
+        uint64_t sum = 0;
+        for (BoardType::Position position : positions) {
+            sum += BoardType::swapPosition(position);
+        }
+        return sum;
+    });
+
+    benchmark("writeLegalMoves", numPositions, [&]() {
+        uint64_t sum = 0;
+        BoardType board;
+        BoardType::Position legalMoves[BoardType::cMaxMoves];
+        for (BoardType::Position position : positions) {
+            board.setPosition(position);
+            int moveCount = board.writeLegalMoves(legalMoves);
+            for (int i=0; i<moveCount; ++i) {
+                sum += legalMoves[i];
+            }
+        }
+        return sum;
+    });
+
+    benchmark("writeUnmoves", numPositions, [&]() {
+        uint64_t sum = 0;
+        BoardType board;
+        BoardType::Position unMoves[BoardType::cMaxMoves];
+        for (BoardType::Position position : positions) {
+            board.setPosition(position);
+            int unMoveCount = board.writeUnmoves(unMoves);
+            for (int i=0; i<unMoveCount; ++i) {
+                sum += unMoves[i];
+            }
+        }
+        return sum;
+    });
+
+    benchmark("MoveBatch", numPositions, [&]() {
+        uint64_t sum = 0;
+        BoardType board;
+        BoardType::Position legalMoves[BoardType::cMaxMoves];
+        MoveBatch<BoardType> batch;
+        for (uint64_t i = 0; i < numPositions; ++i) {
+            if (batch.add(i, positions[i]) || i == numPositions-1) {
+                batch.generate();
+                for (int b=0; b<batch.count(); ++b) {
+                    int moveCount = batch.writeLegalMoves(b, board, legalMoves);
+                    for (int m=0; m<moveCount; ++m) {
+                        sum += legalMoves[m];
+                    }
+                }
+                batch.clear();
+            }
+        }
+        return sum;
+    });
+
+    // Leaf nodes of the game tree from the initial position, without the
+    // cache, so every node is generated.
+    Perft<BoardType> perft(1, 0);
+    const int cPerftDepth = 10;
+    uint64_t dummyHits = 0;
+    benchmark("Perft", perft.count(BoardType().getPosition(), cPerftDepth, dummyHits), [&]() {
+        uint64_t cacheHits = 0;
+        return perft.count(BoardType().getPosition(), cPerftDepth, cacheHits);
+    });
+
+    benchmark("TableBase::readBit", numPositions, [&]() {
+        uint64_t sum = 0;
+        for (uint32_t index : indices) {
+            sum += tb.readBit(index);
+        }
+        return sum;
+    });
+
+    std::cout << std::endl << "  ]" << std::endl;
+    std::cout << "}" << std::endl;
+    return 0;
+} // main
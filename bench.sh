@@ -0,0 +1,89 @@
+#!/bin/sh
+# Benchmark suite, run by "make bench".
+#
+# Usage: bench.sh [board sizes]
+#
+# Runs the microbenchmarks (touchdown_bench), and a timed generate and
+# summarize run of touchdown_db for each board size (default 4x4) and
+# generation mode. The results are written as JSON to bench.json.
+#
+# The summaries of the 4x4 board are checked against the known number of
+# Win and Loss positions, and the script fails if they differ.
+
+set -e
+
+sizes=${*:-4x4}
+out=bench.json
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+ok=true
+
+now() {
+    date +%s.%N
+}
+
+elapsed() {
+    echo "$1 $2" | awk '{ printf "%.3f", $2 - $1 }'
+}
+
+# The generation modes to benchmark for each board size, as name:options.
+# The larger boards only fit in memory when using material slices.
+modes() {
+    case $1 in
+        4x4) echo "sweep: retrograde:-r sliced:-m rank:-x_-r" ;;
+        *)   echo "sliced:-m" ;;
+    esac
+}
+
+{
+    echo "{"
+    echo "  \"micro\":"
+    ./touchdown_db -r "$dir/micro.tb" > /dev/null
+    ./touchdown_bench "$dir/micro.tb" | sed 's/^/  /'
+    echo "  ,"
+    echo "  \"end_to_end\": ["
+
+    first=true
+    for size in $sizes; do
+        for mode in $(modes "$size"); do
+            name=${mode%%:*}
+            options=$(echo "${mode#*:}" | tr '_' ' ')
+            db="$dir/$size-$name.tb"
+
+            start=$(now)
+            ./touchdown_db -n "$size" $options "$db" > /dev/null
+            middle=$(now)
+            summary=$(./touchdown_db -n "$size" $(echo "$options" | sed 's/-[rm]//g') -s "$db")
+            end=$(now)
+
+            win=$(echo "$summary" | awk '/^Win/ { print $3 }')
+            loss=$(echo "$summary" | awk '/^Loss/ { print $3 }')
+
+            check=null
+            if [ "$size" = "4x4" ]; then
+                if [ "$win" = "220104" ] && [ "$loss" = "535487" ]; then
+                    check=true
+                else
+                    check=false
+                    ok=false
+                    echo "Wrong result for $size $name: $win/$loss" >&2
+                fi
+            fi
+
+            $first || echo "    ,"
+            first=false
+            echo "    {\"board\": \"$size\", \"mode\": \"$name\", \"options\": \"$options\","
+            echo "     \"generate_seconds\": $(elapsed "$start" "$middle"),"
+            echo "     \"summarize_seconds\": $(elapsed "$middle" "$end"),"
+            echo "     \"win\": $win, \"loss\": $loss, \"check\": $check}"
+        done
+    done
+
+    echo "  ],"
+    echo "  \"ok\": $ok"
+    echo "}"
+} > "$out"
+
+cat "$out"
+$ok
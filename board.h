@@ -2,27 +2,140 @@
 #define _TOUCHDOWN_BOARD_H
 
 #include <ostream>
+#include <type_traits>
 #include <assert.h>
 #include "index.h"
+#include "rank.h"
+
+// The board position is packed into a single unsigned integer, with twice as
+// many bits as there are squares on the board. This selects the smallest
+// integer type that is wide enough.
+template <int tNumSquares>
+struct BoardPosition
+{
+   static_assert(tNumSquares <= 64, "Board too large");
+
+   typedef typename std::conditional<tNumSquares <= 16, uint32_t,
+           typename std::conditional<tNumSquares <= 32, uint64_t,
+           unsigned __int128>::type>::type Type;
+}; // BoardPosition
+
+// The moves of a pawn from each square, as masks to XOR with a position, see
+// Board::writeLegalMoves, and the same for taking back a move of an opponent
+// pawn to each square, see Board::writeUnmoves. Board::swapPosition only
+// reverses and XORs bits, so swapping the position after a move is the same
+// as XOR'ing the swapped position with the swapped mask of the move. The masks
+// are stored swapped, which saves swapping each generated position. They are
+// computed at compile time, and are zero for the moves that would leave the
+// board.
+template <int tNumRows, int tNumCols, typename Position>
+struct MoveTable
+{
+   static const int cNumSquares = tNumRows * tNumCols;
+
+   Position push[cNumSquares]  = {};   // Forward.
+   Position right[cNumSquares] = {};   // Capture diagonally right.
+   Position left[cNumSquares]  = {};   // Capture diagonally left.
+
+   Position unPush[cNumSquares]  = {};   // Back up.
+   Position unRight[cNumSquares] = {};   // Back up right, restoring a captured player pawn.
+   Position unLeft[cNumSquares]  = {};   // Back up left, restoring a captured player pawn.
+
+   constexpr MoveTable() {
+      for (int square = tNumCols; square < cNumSquares; ++square) {
+         int col = square % tNumCols;
+         push[square] = swap(move(square, square - tNumCols, false));
+         if (col < tNumCols-1) {
+            right[square] = swap(move(square, square - tNumCols + 1, true));
+         }
+         if (col > 0) {
+            left[square] = swap(move(square, square - tNumCols - 1, true));
+         }
+
+         // The opponent pawn on square came from the row above.
+         unPush[square] = swap(((Position) 1 << square) | ((Position) 1 << (square - tNumCols)));
+         if (col < tNumCols-1) {
+            unRight[square] = swap(unCapture(square, square - tNumCols + 1));
+         }
+         if (col > 0) {
+            unLeft[square] = swap(unCapture(square, square - tNumCols - 1));
+         }
+      }
+   }
+
+   // The mask of moving a player pawn from square from to square to, which
+   // holds an opponent pawn if capture is true.
+   static constexpr Position move(int from, int to, bool capture) {
+      Position player   = ((Position) 1 << from) | ((Position) 1 << to);
+      Position occupied = capture ? (Position) 1 << from : player;
+      return (player << cNumSquares) | occupied;
+   }
+
+   // The mask of moving an opponent pawn back from square to the empty square
+   // from, and putting a player pawn on square.
+   static constexpr Position unCapture(int square, int from) {
+      return ((Position) 1 << square << cNumSquares) | ((Position) 1 << from);
+   }
+
+   // The same as Board::swapPosition.
+   static constexpr Position swap(Position position) {
+      Position occupied = reverse(position);
+      Position player   = reverse(position >> cNumSquares);
+      return ((player ^ occupied) << cNumSquares) | occupied;
+   }
+
+   // Reverse the order of the lowest cNumSquares bits.
+   static constexpr Position reverse(Position squares) {
+      Position reversed = 0;
+      for (int i = 0; i < cNumSquares; ++i) {
+         if ((squares >> i) & 1) {
+            reversed |= (Position) 1 << (cNumSquares - 1 - i);
+         }
+      }
+      return reversed;
+   }
+}; // MoveTable
 
 template <int tNumRows, int tNumCols>
 class Board
 {
-   // Construct a 4x4 display of the current board position.
+   public:
+   static const int cNumRows    = tNumRows;
+   static const int cNumCols    = tNumCols;
+   static const int cNumSquares = tNumRows * tNumCols;
+   static const int cNumPawns   = tNumCols;       // Number of pawns each player starts with.
+   static const int cMaxMoves   = 3 * cNumPawns;  // Each pawn has at most three moves.
+
+   // The board representation, see m_position below.
+   typedef typename BoardPosition<cNumSquares>::Type Position;
+
+   // A bit mask with one bit for each square on the board.
+   typedef uint64_t Squares;
+
+   // Masks of specific squares on the board. Row 0 is the opponents back
+   // rank, and the player moves towards it.
+   static constexpr Squares cAllSquares = (cNumSquares == 64) ? ~(Squares) 0 : ((Squares) 1 << cNumSquares) - 1;
+   static constexpr Squares cFirstRow   = ((Squares) 1 << tNumCols) - 1;                  // Row 0.
+   static constexpr Squares cLastRow    = cFirstRow << (cNumSquares - tNumCols);          // Row tNumRows-1.
+   static constexpr Squares cLeftCol    = cAllSquares / cFirstRow;                        // Column 0.
+   static constexpr Squares cRightCol   = cLeftCol << (tNumCols - 1);                     // Column tNumCols-1.
+
+   private:
+   // Construct a display of the current board position, one line per row.
    friend std::ostream& operator<< (std::ostream& os, const Board& board) {
       assert (board.positionIsValid());
-      uint32_t position = board.m_position;
-      for (int i=0; i<16; ++i) {
-         switch (position & 0x10001) {
-            case 0x00000 : os << "."; break;
-            case 0x00001 : os << "O"; break;
-            case 0x10001 : os << "X"; break;
-            default : assert(false);
-         }
-         if ((i&3) == 3) {
+      Squares player   = board.getPlayer();
+      Squares opponent = board.getOpponent();
+      for (int i=0; i<cNumSquares; ++i) {
+         if (player & ((Squares) 1 << i))
+            os << "X";
+         else if (opponent & ((Squares) 1 << i))
+            os << "O";
+         else
+            os << ".";
+         if (i%tNumCols == tNumCols-1) {
             os << std::endl;
          }
-         position /= 2;
       }
       return os;
    } // operator <<
@@ -33,34 +146,77 @@ class Board
       assert (positionIsValid());
       std::string ret;
 
-      uint16_t opponent = m_position & (~(m_position >> 16));
-      uint16_t player = m_position & (m_position >> 16);
+      Squares opponent = getOpponent();
+      Squares player   = getPlayer();
 
-      for (int i=0; i<16; ++i) {
-         if (player & (1<<i))
+      for (int i=0; i<cNumSquares; ++i) {
+         if (player & ((Squares) 1 << i))
             ret += "X";
-         else if (opponent & (1<<i))
+         else if (opponent & ((Squares) 1 << i))
             ret += "O";
          else
             ret += ".";
-         if ((i&3)==3)
+         if (i%tNumCols == tNumCols-1)
             ret += " ";
       }
 
       return ret;
    } // toShortString
 
-   // Construct board from an index value.
-   // The default value corresponds to the initial board position of the game:
+   // Construct board from a one-line display, as written by toShortString.
+   // Spaces are ignored. Returns false if the string is not a board with at
+   // most cNumPawns pawns of each player.
+   bool fromShortString(const std::string& str) {
+      Squares player   = 0;
+      Squares opponent = 0;
+      int i = 0;
+      for (char c : str) {
+         if (c == ' ')
+            continue;
+         if (i >= cNumSquares)
+            return false;
+         switch (c) {
+            case 'X' : player   |= (Squares) 1 << i; break;
+            case 'O' : opponent |= (Squares) 1 << i; break;
+            case '.' : break;
+            default  : return false;
+         }
+         ++i;
+      }
+      if (i != cNumSquares)
+         return false;
+      if (__builtin_popcountll(player) > cNumPawns || __builtin_popcountll(opponent) > cNumPawns)
+         return false;
+
+      m_position = makePosition(player, opponent);
+      return true;
+   } // fromShortString
+
+   // Construct the initial board position of the game, e.g. on the 4x4 board:
    //    OOOO
    //    ....
    //    ....
    //    XXXX
-   Board(uint32_t index = 0xF0F00F) {
+   Board() {
+      m_position = makePosition(cLastRow, cFirstRow);
+   } // Board
+
+   // Construct board from an index value, see index.h.
+   // This is only defined for the 4x4 board.
+   // The value 0xF0F00F corresponds to the initial board position.
+   Board(uint32_t index) {
+      static_assert(cNumSquares == 16, "The 24-bit index is only defined for the 4x4 board");
       assert(indexIsValid(index));
 
       m_position = index & 0xFFFF;
 
+      if (indexUseBmi2) {
+         // Scatter the player bits to the occupied squares.
+         m_position |= indexDepositBitsBmi2(index >> 16, index & 0xFFFF) << 16;
+         assert (positionIsValid());
+         return;
+      }
+
       uint16_t x = index >> 16;
 
       uint16_t mask = 0x0001;
@@ -79,9 +235,18 @@ class Board
    } // Board
 
    // Recreate the index value from the current board position.
+   // This is only defined for the 4x4 board.
    uint32_t getIndex() const {
+      static_assert(cNumSquares == 16, "The 24-bit index is only defined for the 4x4 board");
       assert (positionIsValid());
 
+      if (indexUseBmi2) {
+         // Gather the player bits of the occupied squares.
+         uint32_t index = (indexExtractBitsBmi2(getPlayer(), getOccupied()) << 16) | getOccupied();
+         assert (indexIsValid(index));
+         return index;
+      }
+
       uint16_t maskP = 0x0001;
       uint16_t maskX = 0x0001;
       uint8_t x = 0;
@@ -99,27 +264,84 @@ class Board
       return index;
    } // getIndex
 
+   // Construct board from a rank value, see rank.h.
+   static Board fromRank(uint64_t rank) {
+      uint64_t player;
+      uint64_t opponent;
+      Rank<tNumRows, tNumCols>::unrank(rank, player, opponent);
+
+      Board board;
+      board.setPosition(makePosition(player, opponent));
+      assert (board.positionIsValid());
+      return board;
+   } // fromRank
+
+   // Recreate the rank value from the current board position.
+   // This is only defined for legal positions, i.e. when isWin() is false.
+   uint64_t getRank() const {
+      assert (positionIsValid());
+      assert (!isWin());
+
+      return Rank<tNumRows, tNumCols>::rank(getPlayer(), getOpponent());
+   } // getRank
+
    // Checks the board invariant, that the player pawns must be on non-empty
    // squares.
    bool positionIsValid() const {
-      return (((~m_position) & (m_position >> 16)) == 0);
+      return (((~getOccupied()) & getPlayer()) == 0);
    } // positionIsValid
 
-   uint32_t getPosition() const {
+   Position getPosition() const {
       return m_position;
    }
 
-   void setPosition(uint32_t position) {
+   void setPosition(Position position) {
       m_position = position;
    }
 
+   // Return the squares occupied by either player.
+   Squares getOccupied() const {
+      return (Squares) (m_position & cAllSquares);
+   }
+
+   // Return the squares occupied by the player to move.
+   Squares getPlayer() const {
+      return (Squares) (m_position >> cNumSquares);
+   }
+
+   // Return the squares occupied by the opponent.
+   Squares getOpponent() const {
+      return getOccupied() & ~getPlayer();
+   }
+
+   // Pack the player and opponent pawns into a board representation.
+   static Position makePosition(Squares player, Squares opponent) {
+      assert (!(player & opponent));
+      return ((Position) player << cNumSquares) | player | opponent;
+   }
+
+   // Return the total number of rows advanced by the pawns of both players.
+   // Every move that is not a capture increases this by one, and the value is
+   // unchanged by swapPosition.
+   int getAdvancement() const {
+      Squares player   = getPlayer();
+      Squares opponent = getOpponent();
+      Squares rowMask  = cFirstRow;
+      int advancement  = 0;
+      for (int row=0; row<tNumRows; ++row, rowMask <<= tNumCols) {
+         advancement += __builtin_popcountll(player & rowMask) * (tNumRows-1-row);
+         advancement += __builtin_popcountll(opponent & rowMask) * row;
+      }
+      return advancement;
+   } // getAdvancement
+
    // Return true if the game is already lost for the player to move
    // This is the case if the opponent has a piece on the first row,
    // or if the player has no pieces left.
    bool isLoss() const {
-      uint16_t player   = m_position & (m_position >> 16);
-      uint16_t opponent = m_position & (~(m_position >> 16));
-      if (opponent & 0xF000)
+      Squares player   = getPlayer();
+      Squares opponent = getOpponent();
+      if (opponent & cLastRow)
          return true;
       if (!player)
          return true;
@@ -130,93 +352,237 @@ class Board
    // This is the case if the player has a piece on the last row,
    // or if the opponent has no pieces left.
    bool isWin() const {
-      uint16_t player   = m_position & (m_position >> 16);
-      uint16_t opponent = m_position & (~(m_position >> 16));
-      if (player & 0x000F)
+      Squares player   = getPlayer();
+      Squares opponent = getOpponent();
+      if (player & cFirstRow)
          return true;
       if (!opponent)
          return true;
       return false;
    }
 
+   // Return the squares in reverse order, i.e. square i becomes square
+   // cNumSquares-1-i.
+   static Squares reverseSquares(Squares squares) {
+      if (cNumSquares == 16)
+         return indexReverse16(squares);
+      return indexReverse64(squares) >> (64 - cNumSquares);
+   } // reverseSquares
+
    // Rotates the board, to view it from the opponets side.
-   static uint32_t swapPosition(uint32_t position) {
-      uint32_t newPosition = (indexReverse16(position >> 16) << 16) | indexReverse16(position & 0xFFFF);
-      newPosition ^= (newPosition & 0xFFFF) << 16;
-      return newPosition;
+   // When the position fits in 64 bits, both halves are reversed at once:
+   // reversing the whole position also swaps the halves, so the reversed
+   // occupied squares end up in the high half.
+   static Position swapPosition(Position position) {
+      Squares occupied;
+      Squares player;
+      if (2 * cNumSquares <= 64) {
+         uint64_t reversed = indexReverse64((uint64_t) position) >> (64 - 2 * cNumSquares);
+         occupied = (Squares) (reversed >> cNumSquares);
+         player   = (Squares) (reversed & cAllSquares);
+      } else {
+         occupied = reverseSquares((Squares) (position & cAllSquares));
+         player   = reverseSquares((Squares) (position >> cNumSquares));
+      }
+      return ((Position) (player ^ occupied) << cNumSquares) | occupied;
    } // swapPosition
 
+   // Return a 64-bit hash key of a position, e.g. for a transposition table.
+   static uint64_t hashPosition(Position position) {
+      uint64_t low  = (uint64_t) position;
+      uint64_t high = (sizeof(Position) > 8) ? (uint64_t) (position >> (4 * sizeof(Position))) : 0;
+      uint64_t key  = low * 0x9E3779B97F4A7C15 ^ high * 0xC2B2AE3D27D4EB4F;
+      key ^= key >> 32;
+      key *= 0xD6E8FEB86659FD93;
+      return key ^ (key >> 32);
+   } // hashPosition
+
+   // Return the squares mirrored left to right, i.e. column c becomes column
+   // tNumCols-1-c.
+   static Squares mirrorSquares(Squares squares) {
+      Squares mirrored = 0;
+      for (int col=0; col<tNumCols; ++col) {
+         mirrored |= ((squares >> col) & cLeftCol) << (tNumCols-1-col);
+      }
+      return mirrored;
+   } // mirrorSquares
+
+   // Return the board mirrored left to right. The game is symmetric, so the
+   // mirrored position has the same game value.
+   Board getMirror() const {
+      Board board;
+      board.setPosition(makePosition(mirrorSquares(getPlayer()), mirrorSquares(getOpponent())));
+      return board;
+   } // getMirror
+
+   // Return the canonical one of the board and its mirror image, which is the
+   // one whose player pawns form the smaller number, or whose opponent pawns do
+   // if the player pawns are symmetric.
+   Board getCanonical() const {
+      Squares player         = getPlayer();
+      Squares mirroredPlayer = mirrorSquares(player);
+      if (mirroredPlayer < player)
+         return getMirror();
+      if (mirroredPlayer == player && mirrorSquares(getOpponent()) < getOpponent())
+         return getMirror();
+      return *this;
+   } // getCanonical
+
+   // Return true if the board is its own mirror image.
+   bool isSymmetric() const {
+      return mirrorSquares(getPlayer()) == getPlayer() && mirrorSquares(getOpponent()) == getOpponent();
+   }
+
+   // Find the player pawns that can move, without looping over the squares.
+   // Each bit set in push, right, or left is a pawn that can move forward,
+   // capture diagonally right, or capture diagonally left, respectively.
+   // This only uses shifts and masks, so it can be evaluated for many
+   // positions in parallel, see movegen.h.
+   static void getMoveSources(Position position, Squares& push, Squares& right, Squares& left) {
+      Squares occupied = (Squares) (position & cAllSquares);
+      Squares player   = (Squares) (position >> cNumSquares);
+      Squares opponent = occupied & ~player;
+
+      push  = player & ~(occupied << tNumCols);                     // Square in front is empty.
+      right = player & ~cRightCol & (opponent << (tNumCols-1));     // Square diagonally right contains an opponent.
+      left  = player & ~cLeftCol  & (opponent << (tNumCols+1));     // Square diagonally left contains an opponent.
+   } // getMoveSources
+
    // Generate a list of all the legal moves in the current position.
-   int writeLegalMoves(uint32_t legalMoves[12]) const {
+   int writeLegalMoves(Position legalMoves[cMaxMoves]) const {
       assert (positionIsValid());   // Check board invariant
       assert (!isWin());            // No pawns on the back row.
 
-      uint16_t player   = m_position & (m_position >> 16);
-      uint16_t opponent = m_position & (~(m_position >> 16));
+      Squares push;
+      Squares right;
+      Squares left;
+      getMoveSources(m_position, push, right, left);
+
+      return writeLegalMoves(push, right, left, legalMoves);
+   } // writeLegalMoves
+
+   // Generate a list of all the legal moves in the current position, given
+   // the pawns that can move, as returned by getMoveSources.
+   // The moves are ordered by square, e.g. on the 4x4 board:
+   //  0  1  2  3
+   //  4  5  6  7
+   //  8  9 10 11
+   // 12 13 14 15
+   // and for each square: forward, diagonally right, and diagonally left.
+   // The position is swapped once, and each move is then a lookup in
+   // cMoveTable. All three moves of a pawn are written, but only the legal
+   // ones are counted, so the next move overwrites the others, and there is
+   // no branch on which moves the pawn has. Each pawn has at least one move,
+   // so this never writes beyond cMaxMoves.
+   int writeLegalMoves(Squares push, Squares right, Squares left, Position legalMoves[cMaxMoves]) const {
+      assert (positionIsValid());   // Check board invariant
+      assert (!isWin());            // No pawns on the back row.
+
+      Position swapped = swapPosition(m_position);
+      Squares  sources = push | right | left;
 
-      //  0  1  2  3
-      //  4  5  6  7
-      //  8  9 10 11
-      // 12 13 14 15
-      uint16_t mask = 0x0010;   // Skip last row, i.e. bits 0 - 3.
-      
       int moveCount = 0;
-      // Loop over all squares
-      for (int i=0; i<12; ++i, mask *= 2) {
-         // Look for a player pawn.
-         if (!(player & mask)) {
-            continue;
-         }
+      // Loop over all pawns that can move
+      while (sources) {
+         int square = __builtin_ctzll(sources);
+         sources &= sources - 1;
+
+         legalMoves[moveCount] = swapped ^ cMoveTable.push[square];
+         moveCount += (push >> square) & 1;
+         legalMoves[moveCount] = swapped ^ cMoveTable.right[square];
+         moveCount += (right >> square) & 1;
+         legalMoves[moveCount] = swapped ^ cMoveTable.left[square];
+         moveCount += (left >> square) & 1;
+      } // end while
+
+#ifndef NDEBUG
+      for (int i=0; i<moveCount; ++i) {
+         assert (Board(legalMoves[i], 0).positionIsValid());
+      }
+#endif
+      return moveCount;
+   } // writeLegalMoves
 
-         // Is square in front empty?
-         uint16_t newMask = mask >> 4;
-         if (!(m_position & newMask)) {
-            // Move pawn up one row.
-            uint32_t moveMask = mask | newMask;
-            moveMask |= moveMask << 16;
-            uint32_t newPosition = swapPosition(m_position ^ moveMask);
+   // Generate a list of all the positions, from which the current position
+   // can be reached by a single legal move. This is the reverse of
+   // writeLegalMoves: the current position is among the legal moves of each
+   // of the positions returned. The positions returned are seen from the
+   // opponents side, i.e. with the opponent to move. As in writeLegalMoves,
+   // the position is swapped once, and each un-move is a lookup in
+   // cMoveTable.
+   int writeUnmoves(Position unMoves[cMaxMoves]) const {
+      assert (positionIsValid());   // Check board invariant
 
-            legalMoves[moveCount++] = newPosition;
-            assert (((~newPosition) & (newPosition >> 16)) == 0);
-         }
+      Position swapped     = swapPosition(m_position);
+      Squares  player      = getPlayer();
+      Squares  opponent    = getOpponent();
+      int      playerCount = __builtin_popcountll(player);
 
-         // Does the square diagnoally right contain an opponent?
-         newMask = mask >> 3;
-         const uint16_t maskRight = 0x8888; // All square in the right-most coloumn.
-         if (!(mask & maskRight) && (opponent & newMask)) {
+      // The opponent made the last move, i.e. moved a pawn down the board.
+      Squares mask = (Squares) 1 << tNumCols;   // Skip first row, i.e. row 0. No opponent pawn can have arrived there.
 
-            // Capture pawn up right one row.
-            uint32_t moveMask = mask | (mask << 16);  // Remove player from original square
-            moveMask |= (newMask << 16);              // Capture opponent on new square
-            uint32_t newPosition = swapPosition(m_position ^ moveMask);
+      int unMoveCount = 0;
+      // Loop over all squares
+      for (int i=tNumCols; i<cNumSquares; ++i, mask *= 2) {
+         // Look for an opponent pawn.
+         if (!(opponent & mask)) {
+            continue;
+         }
 
-            legalMoves[moveCount++] = newPosition;
-            assert (((~newPosition) & (newPosition >> 16)) == 0);
+         // Is square behind empty?
+         Squares oldMask = mask >> tNumCols;
+         if (!(getOccupied() & oldMask)) {
+            // Move pawn back up one row.
+            addUnmove(swapped ^ cMoveTable.unPush[i], unMoves, unMoveCount);
          }
 
-         // Does the square diagnoally left contain an opponent?
-         newMask = mask >> 5;
-         const uint16_t maskLeft  = 0x1111; // All squares in the left-most coloumn.
-         if (!(mask & maskLeft) && (opponent & newMask)) {
+         // A capture can only be undone if there is room for the captured pawn.
+         if (playerCount >= cNumPawns) {
+            continue;
+         }
 
-            // Capture pawn up left one row.
-            uint32_t moveMask = mask | (mask << 16);  // Remove player from original square
-            moveMask |= (newMask << 16);              // Capture opponent on new square
-            uint32_t newPosition = swapPosition(m_position ^ moveMask);
+         // Is the square diagonally up right empty?
+         oldMask = mask >> (tNumCols-1);
+         if (!(mask & cRightCol) && !(getOccupied() & oldMask)) {
+            // Move pawn back up right one row, and restore the captured player pawn.
+            addUnmove(swapped ^ cMoveTable.unRight[i], unMoves, unMoveCount);
+         }
 
-            legalMoves[moveCount++] = newPosition;
-            assert (((~newPosition) & (newPosition >> 16)) == 0);
+         // Is the square diagonally up left empty?
+         oldMask = mask >> (tNumCols+1);
+         if (!(mask & cLeftCol) && !(getOccupied() & oldMask)) {
+            // Move pawn back up left one row, and restore the captured player pawn.
+            addUnmove(swapped ^ cMoveTable.unLeft[i], unMoves, unMoveCount);
          }
       } // end for
 
-      return moveCount;
-   } // writeLegalMoves
+      return unMoveCount;
+   } // writeUnmoves
 
    private:
-   // Bits 15-0 indicate whether the square is occupied or not.
-   // Bits 31-16 indicate whether the squares is occupied by the player.
-   // The initial position is given by 0xF000F00F.
-   uint32_t m_position;
+   static constexpr MoveTable<tNumRows, tNumCols, Position> cMoveTable{};
+
+   // Construct board directly from the board representation.
+   Board(Position position, int) : m_position(position) {
+   }
+
+   // Add a candidate previous position, seen from the opponents side, to the
+   // list of un-moves, but only if the opponent could actually have moved from
+   // there, i.e. if the game was not already over.
+   static void addUnmove(Position position, Position unMoves[cMaxMoves], int& unMoveCount) {
+      Board previous(position, 0);
+      assert (previous.positionIsValid());
+      if (previous.isWin() || previous.isLoss()) {
+         return;
+      }
+      unMoves[unMoveCount++] = previous.getPosition();
+   } // addUnmove
+
+   // Bits cNumSquares-1 to 0 indicate whether the square is occupied or not.
+   // Bits 2*cNumSquares-1 to cNumSquares indicate whether the squares is
+   // occupied by the player.
+   // On the 4x4 board the initial position is given by 0xF000F00F.
+   Position m_position;
 }; // class Board
 
 #endif // _TOUCHDOWN_BOARD_H
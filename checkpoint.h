@@ -0,0 +1,171 @@
+#ifndef _TOUCHDOWN_CHECKPOINT_H
+#define _TOUCHDOWN_CHECKPOINT_H
+
+#include <string>
+#include <vector>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <assert.h>
+#include "tablebase.h"
+
+// A checkpoint of a long running database generation, so it can be resumed
+// after a crash or reboot. The tables being written are kept in memory, or
+// mapped to files where whatever pages reached the disk before a crash may be
+// from different points in time. Therefore a checkpoint holds a consistent
+// copy of the state instead:
+// * A counter of the work done, e.g. the number of passes or slices.
+// * A copy of each table, e.g. the database and the table of known positions.
+// * A list of values, e.g. the checksums of the slices that are finished.
+// The state is written to a temporary file, which is synced to disk, and then
+// renamed to e.g. "touchdown.tb.ckpt". So the checkpoint file is always
+// either the previous or the next complete checkpoint. A checksum of the
+// state detects a checkpoint that was damaged anyway.
+class Checkpoint
+{
+   public:
+      Checkpoint(const std::string& baseName, const std::string& scheme, uint64_t numPositions)
+         : m_fileName(baseName + ".ckpt")
+      {
+         m_header = {};
+         memcpy(m_header.magic, cMagic, sizeof(m_header.magic));
+         m_header.version      = cVersion;
+         m_header.numPositions = numPositions;
+         assert (scheme.size() < sizeof(m_header.scheme));
+         strcpy(m_header.scheme, scheme.c_str());
+      }
+
+      // Return a checksum of size bytes, continuing from the checksum seed.
+      static uint64_t checksum(const uint8_t *data, size_t size, uint64_t seed = 0) {
+         uint64_t hash = seed ^ 0xcbf29ce484222325;    // FNV-1a, on 8 bytes at a time.
+         size_t i = 0;
+         for (; i + 8 <= size; i += 8) {
+            uint64_t word;
+            memcpy(&word, data + i, 8);
+            hash = (hash ^ word) * 0x100000001b3;
+         }
+         for (; i < size; ++i) {
+            hash = (hash ^ data[i]) * 0x100000001b3;
+         }
+         return hash;
+      } // checksum
+
+      // Write a checkpoint with the given counter, tables and values.
+      void save(uint64_t counter, const std::vector<TableBase*>& tables, const std::vector<uint64_t>& values) {
+         Header header = m_header;
+         header.counter   = counter;
+         header.numTables = tables.size();
+         header.numValues = values.size();
+         header.checksum  = stateChecksum(tables, values);
+
+         std::string tempName = m_fileName + ".tmp";
+         FILE *file = fopen(tempName.c_str(), "wb");
+         if (!file)
+         {
+            perror("fopen");
+            assert (false);
+         }
+
+         bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+         for (TableBase *table : tables) {
+            uint64_t size = table->size();
+            ok = ok && fwrite(&size, sizeof(size), 1, file) == 1;
+            ok = ok && fwrite(table->data(), 1, size, file) == size;
+         }
+         ok = ok && fwrite(values.data(), sizeof(uint64_t), values.size(), file) == values.size();
+         ok = ok && fflush(file) == 0 && fsync(fileno(file)) == 0;
+         ok = (fclose(file) == 0) && ok;
+         if (!ok || rename(tempName.c_str(), m_fileName.c_str()))
+         {
+            perror("checkpoint");
+            assert (false);
+         }
+      } // save
+
+      // Read the last checkpoint, and copy its tables to tables, and its
+      // values to values. Returns false, and leaves everything unchanged, if
+      // there is no valid checkpoint for this database.
+      bool restore(uint64_t& counter, const std::vector<TableBase*>& tables, std::vector<uint64_t>& values) const {
+         FILE *file = fopen(m_fileName.c_str(), "rb");
+         if (!file) {
+            return false;
+         }
+
+         Header header;
+         bool ok = fread(&header, sizeof(header), 1, file) == 1
+            && !memcmp(header.magic, m_header.magic, sizeof(header.magic))
+            && header.version == m_header.version
+            && header.numPositions == m_header.numPositions
+            && !strcmp(header.scheme, m_header.scheme)
+            && header.numTables == tables.size();
+
+         // Read everything into memory first, and only copy it to the
+         // tables when the checksum is correct.
+         std::vector<std::vector<uint8_t>> copies(tables.size());
+         for (size_t t = 0; ok && t < tables.size(); ++t) {
+            uint64_t size;
+            ok = fread(&size, sizeof(size), 1, file) == 1 && size == (uint64_t) tables[t]->size();
+            if (ok) {
+               copies[t].resize(size);
+               ok = fread(copies[t].data(), 1, size, file) == size;
+            }
+         }
+         std::vector<uint64_t> savedValues(ok ? header.numValues : 0);
+         ok = ok && fread(savedValues.data(), sizeof(uint64_t), savedValues.size(), file) == savedValues.size();
+         fclose(file);
+
+         uint64_t sum = 0;
+         for (size_t t = 0; ok && t < copies.size(); ++t) {
+            sum = checksum(copies[t].data(), copies[t].size(), sum);
+         }
+         if (!ok || checksum((const uint8_t *) savedValues.data(), savedValues.size() * sizeof(uint64_t), sum) != header.checksum) {
+            fprintf(stderr, "%s: Invalid checkpoint\n", m_fileName.c_str());
+            return false;
+         }
+
+         for (size_t t = 0; t < tables.size(); ++t) {
+            memcpy(tables[t]->data(), copies[t].data(), copies[t].size());
+         }
+         values  = savedValues;
+         counter = header.counter;
+         return true;
+      } // restore
+
+      // Remove the checkpoint, when the generation is complete.
+      void remove() const {
+         unlink(m_fileName.c_str());
+      }
+
+   private:
+      static constexpr char    cMagic[8] = {'T', 'D', 'C', 'K', 'P', 'T', '\0', '\0'};
+      static const     uint32_t cVersion = 1;
+
+      struct Header {
+         char     magic[8];       // cMagic.
+         uint32_t version;        // cVersion.
+         uint32_t numTables;
+         uint64_t numPositions;   // Number of positions of the index scheme.
+         uint64_t numValues;
+         uint64_t counter;
+         uint64_t checksum;       // Checksum of the tables and values.
+         char     scheme[16];     // Name of the index scheme, e.g. "4x4r".
+      }; // Header
+
+      static uint64_t stateChecksum(const std::vector<TableBase*>& tables, const std::vector<uint64_t>& values) {
+         uint64_t sum = 0;
+         for (TableBase *table : tables) {
+            sum = checksum(table->data(), table->size(), sum);
+         }
+         return checksum((const uint8_t *) values.data(), values.size() * sizeof(uint64_t), sum);
+      } // stateChecksum
+
+      std::string m_fileName;
+      Header      m_header;
+
+}; // Checkpoint
+
+#endif // _TOUCHDOWN_CHECKPOINT_H
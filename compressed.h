@@ -0,0 +1,427 @@
+#ifndef _TOUCHDOWN_COMPRESSED_H
+#define _TOUCHDOWN_COMPRESSED_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <mutex>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <assert.h>
+#include "tablebase.h"
+
+// A compressed, read-only version of a TableBase file, for distributing the
+// databases. The bitmap is split into blocks of cBlockSize bytes, and each
+// block is compressed on its own, so a single position can be looked up by
+// decompressing just one block.
+//
+// The file consists of:
+// * The header, see below, which describes the board and the index scheme.
+// * The offset table, with numBlocks+1 64-bit file offsets. Block i is stored
+//   from offsets[i] up to offsets[i+1].
+// * The compressed blocks.
+//
+// The blocks are compressed with run-length encoding, where each run starts
+// with a control byte c:
+//    c < 128  : The next c+1 bytes are copied as they are.
+//    c >= 128 : The next byte is repeated c-126 times, i.e. 2 to 129 times.
+// Long runs are common, e.g. the invalid index values of the 24-bit index
+// are all WIN, and many material classes are mostly WIN or mostly LOSS.
+//
+// The readBit method is the same as for TableBase, and the most recently
+// used blocks are kept decompressed in a small cache. The cache is split into
+// shards, each with its own lock, and block b is cached in shard
+// b % cNumShards. So threads that read different blocks, e.g. the workers of
+// -v and -e, or the callers of the library, rarely wait for each other.
+class CompressedTableBase
+{
+   public:
+      static const uint32_t cVersion      = 1;
+      static const uint32_t cBlockSize    = 4096;
+      static const uint32_t cMaxBlockSize = 1 << 20;   // Largest block size accepted when reading.
+      static const int      cNumShards    = 64;
+      static const int      cNumWays      = 4;           // Blocks cached per shard.
+
+      struct Header {
+         char     magic[8];       // cMagic.
+         uint32_t version;        // cVersion.
+         uint32_t blockSize;      // Number of uncompressed bytes per block.
+         uint32_t numRows;        // Board size.
+         uint32_t numCols;
+         uint64_t numPositions;   // Number of bits in the table.
+         uint64_t numBlocks;
+         char     scheme[16];     // Name of the index scheme, e.g. "4x4r".
+      }; // Header
+
+      // Open the compressed database fileName, which must have been written
+      // for the index scheme named scheme (see Index::name) on a board of
+      // numRows x numCols, and hold numPositions bits. The header and the
+      // offset table are checked, so a wrong or damaged file is rejected
+      // here, rather than read out of bounds later.
+      CompressedTableBase(const std::string& fileName, ssize_t numPositions,
+                          const std::string& scheme, int numRows, int numCols)
+      {
+         std::string error = openFile(fileName, numPositions, scheme, numRows, numCols);
+         if (!error.empty())
+         {
+            fprintf(stderr, "%s: %s\n", fileName.c_str(), error.c_str());
+            assert (false);
+         }
+      }
+
+      ~CompressedTableBase()
+      {
+         if (m_file != MAP_FAILED) {
+            munmap((void *) m_file, m_size);
+         }
+         if (m_fd >= 0) {
+            close(m_fd);
+         }
+      }
+
+      // Return true if the file is a compressed database.
+      static bool isCompressed(const std::string& fileName) {
+         char magic[sizeof(cMagic)] = {};
+         int fd = open(fileName.c_str(), O_RDONLY);
+         if (fd < 0)
+            return false;
+         bool compressed = read(fd, magic, sizeof(magic)) == sizeof(magic) && !memcmp(magic, cMagic, sizeof(magic));
+         close(fd);
+         return compressed;
+      } // isCompressed
+
+      const Header& header() const {
+         return *m_header;
+      }
+
+      // Return the bit of position pos, or -1 if its block is damaged. The
+      // header and the offsets are checked when the file is opened, but the
+      // contents of a block only when it is decompressed, so the callers that
+      // must not fail (e.g. the library) use this rather than readBit.
+      //
+      // This is thread safe, as each shard of the cache is protected by its
+      // own mutex.
+      int tryReadBit(uint64_t pos) const {
+         uint64_t byte  = pos/8;
+         uint64_t block = byte / m_blockSize;
+         Shard& shard = m_shards[block % cNumShards];
+         std::lock_guard<std::mutex> lock(shard.mutex);
+         const std::vector<uint8_t> *data = lookupBlock(shard, block);
+         if (!data) {
+            return -1;
+         }
+         return ((*data)[byte % m_blockSize] >> (pos%8)) & 1;
+      } // tryReadBit
+
+      // The same, but a damaged block ends the program.
+      int readBit(uint64_t pos) const {
+         int bit = tryReadBit(pos);
+         if (bit < 0)
+         {
+            fprintf(stderr, "Compressed database: Block %lu is damaged\n", (unsigned long) (pos/8 / m_blockSize));
+            exit(EXIT_FAILURE);
+         }
+         return bit;
+      }
+
+      int readBitAtomic(uint64_t pos) const {
+         return readBit(pos);
+      }
+
+      // Blocks are only decompressed when read.
+      void prefetch(uint64_t) const {
+      }
+
+      // Write a compressed copy of tb, which holds numPositions bits, to the
+      // file fileName. Returns false if it could not be written, in which
+      // case no partial file is left behind.
+      static bool compress(const TableBase& tb, const std::string& fileName, uint64_t numPositions,
+                           int numRows, int numCols, const std::string& scheme) {
+         Header header = {};
+         memcpy(header.magic, cMagic, sizeof(header.magic));
+         header.version      = cVersion;
+         header.blockSize    = cBlockSize;
+         header.numRows      = numRows;
+         header.numCols      = numCols;
+         header.numPositions = numPositions;
+         header.numBlocks    = (tb.size() + cBlockSize - 1) / cBlockSize;
+         assert (scheme.size() < sizeof(header.scheme));
+         strcpy(header.scheme, scheme.c_str());
+
+         FILE *file = fopen(fileName.c_str(), "wb");
+         if (!file)
+         {
+            perror("fopen");
+            return false;
+         }
+
+         // Report the failed call, and remove the partial file.
+         auto fail = [&](const char *what) {
+            perror(what);
+            if (file) {
+               fclose(file);
+            }
+            unlink(fileName.c_str());
+            return false;
+         };
+
+         // The offset table is written last, when the block sizes are known.
+         std::vector<uint64_t> offsets(header.numBlocks + 1);
+         offsets[0] = sizeof(Header) + offsets.size() * sizeof(uint64_t);
+         if (fwrite(&header, sizeof(header), 1, file) != 1 ||
+             fwrite(offsets.data(), sizeof(uint64_t), offsets.size(), file) != offsets.size()) {
+            return fail("fwrite");
+         }
+
+         std::vector<uint8_t> block;
+         for (uint64_t i=0; i<header.numBlocks; ++i) {
+            uint64_t begin = i * cBlockSize;
+            uint64_t end   = std::min<uint64_t>(begin + cBlockSize, tb.size());
+            block.clear();
+            encode(tb.data() + begin, end - begin, block);
+            if (fwrite(block.data(), 1, block.size(), file) != block.size()) {
+               return fail("fwrite");
+            }
+            offsets[i+1] = offsets[i] + block.size();
+         }
+
+         if (fseek(file, sizeof(Header), SEEK_SET)) {
+            return fail("fseek");
+         }
+         if (fwrite(offsets.data(), sizeof(uint64_t), offsets.size(), file) != offsets.size()) {
+            return fail("fwrite");
+         }
+         if (fflush(file) || fsync(fileno(file))) {
+            return fail("fsync");
+         }
+         int result = fclose(file);
+         file = nullptr;
+         if (result) {
+            return fail("fclose");
+         }
+         return true;
+      } // compress
+
+   protected:
+      // Construct a table without a file, that is then opened by openFile.
+      CompressedTableBase()
+      {
+      }
+
+      // Open and check the file, see the constructor. Returns an error
+      // message, or an empty string if the file is good.
+      std::string openFile(const std::string& fileName, ssize_t numPositions,
+                           const std::string& scheme, int numRows, int numCols) {
+         m_fd = open(fileName.c_str(), O_RDONLY);
+         if (m_fd < 0) {
+            return std::string("open: ") + strerror(errno);
+         }
+
+         struct stat st;
+         if (fstat(m_fd, &st) || st.st_size < (ssize_t) sizeof(Header)) {
+            return "File too small";
+         }
+         m_size = st.st_size;
+
+         m_file = (const uint8_t *) mmap(nullptr, m_size, PROT_READ, MAP_SHARED, m_fd, 0);
+         if (m_file == MAP_FAILED) {
+            return std::string("mmap: ") + strerror(errno);
+         }
+
+         m_header = (const Header *) m_file;
+         if (memcmp(m_header->magic, cMagic, sizeof(m_header->magic)) || m_header->version != cVersion) {
+            return "Not a compressed database";
+         }
+         std::string fileScheme(m_header->scheme, strnlen(m_header->scheme, sizeof(m_header->scheme)));
+         if (fileScheme != scheme || m_header->numRows != (uint32_t) numRows || m_header->numCols != (uint32_t) numCols ||
+             m_header->numPositions != (uint64_t) numPositions) {
+            return "Database of " + std::to_string(m_header->numCols) + "x" + std::to_string(m_header->numRows) +
+                   " board with " + fileScheme + " index, expected " + scheme + " index with " +
+                   std::to_string(numPositions) + " positions";
+         }
+         if (m_header->blockSize == 0 || m_header->blockSize > cMaxBlockSize) {
+            return "Bad block size " + std::to_string(m_header->blockSize);
+         }
+         m_blockSize = m_header->blockSize;
+         m_tableSize = (numPositions + 7) / 8;
+         if (m_header->numBlocks != (m_tableSize + m_blockSize - 1) / m_blockSize) {
+            return "Bad number of blocks";
+         }
+
+         // The offsets must increase, from the end of the offset table to at
+         // most the end of the file.
+         uint64_t tableEnd = sizeof(Header) + (m_header->numBlocks + 1) * sizeof(uint64_t);
+         if (m_size < tableEnd) {
+            return "File too small";
+         }
+         m_offsets = (const uint64_t *) (m_file + sizeof(Header));
+         if (m_offsets[0] < tableEnd || m_offsets[m_header->numBlocks] > m_size) {
+            return "Bad block offsets";
+         }
+         for (uint64_t i=0; i<m_header->numBlocks; ++i) {
+            if (m_offsets[i] >= m_offsets[i+1]) {
+               return "Bad block offsets";
+            }
+         }
+
+         for (Shard& shard : m_shards) {
+            for (CachedBlock& cached : shard.blocks) {
+               cached.block   = ~(uint64_t) 0;
+               cached.lastUse = 0;
+               cached.data.resize(m_blockSize);
+            }
+         }
+         return "";
+      } // openFile
+
+   private:
+      static constexpr char cMagic[8] = {'T', 'D', 'T', 'B', 'R', 'L', 'E', '\0'};
+
+      // Run-length encode size bytes.
+      static void encode(const uint8_t *data, size_t size, std::vector<uint8_t>& out) {
+         size_t i = 0;
+         while (i < size) {
+            // Find the length of the run starting here.
+            size_t run = 1;
+            while (i + run < size && run < 129 && data[i+run] == data[i]) {
+               ++run;
+            }
+            if (run >= 2) {
+               out.push_back(run + 126);
+               out.push_back(data[i]);
+               i += run;
+               continue;
+            }
+
+            // Copy bytes up to the next run.
+            size_t literal = 1;
+            while (i + literal < size && literal < 128 &&
+                   !(i + literal + 1 < size && data[i+literal] == data[i+literal+1])) {
+               ++literal;
+            }
+            out.push_back(literal - 1);
+            out.insert(out.end(), data + i, data + i + literal);
+            i += literal;
+         }
+      } // encode
+
+      // Decode the run-length encoded bytes [in, inEnd) to [out, outEnd).
+      // Returns false if the runs do not fill the output exactly, i.e. the
+      // block is damaged. Nothing is read or written out of bounds.
+      static bool decode(const uint8_t *in, const uint8_t *inEnd, uint8_t *out, uint8_t *outEnd) {
+         while (in < inEnd) {
+            uint8_t control = *in++;
+            if (control < 128) {
+               size_t count = control + 1;
+               if (count > (size_t) (inEnd - in) || count > (size_t) (outEnd - out)) {
+                  return false;
+               }
+               memcpy(out, in, count);
+               out += count;
+               in  += count;
+            } else {
+               size_t count = control - 126;
+               if (in == inEnd || count > (size_t) (outEnd - out)) {
+                  return false;
+               }
+               memset(out, *in++, count);
+               out += count;
+            }
+         }
+         return out == outEnd;
+      } // decode
+
+      struct CachedBlock {
+         uint64_t             block;
+         uint64_t             lastUse;
+         std::vector<uint8_t> data;
+      }; // CachedBlock
+
+      struct Shard {
+         std::mutex  mutex;
+         CachedBlock blocks[cNumWays];
+         uint64_t    useCount = 0;
+      }; // Shard
+
+      // Return the decompressed block, from its shard of the cache if
+      // possible. Otherwise it replaces the least recently used block of the
+      // shard. Returns nullptr if the block is damaged, i.e. it does not
+      // decode to exactly the size of the block. The shard must be locked.
+      const std::vector<uint8_t> *lookupBlock(Shard& shard, uint64_t block) const {
+         ++shard.useCount;
+         CachedBlock *victim = &shard.blocks[0];
+         for (CachedBlock& cached : shard.blocks) {
+            if (cached.block == block) {
+               cached.lastUse = shard.useCount;
+               return &cached.data;
+            }
+            if (cached.lastUse < victim->lastUse) {
+               victim = &cached;
+            }
+         }
+
+         if (block >= m_header->numBlocks) {
+            return nullptr;
+         }
+
+         // The last block may be shorter.
+         size_t size = std::min<uint64_t>(m_blockSize, m_tableSize - block * m_blockSize);
+         victim->block = ~(uint64_t) 0;
+         if (!decode(m_file + m_offsets[block], m_file + m_offsets[block+1], victim->data.data(), victim->data.data() + size)) {
+            return nullptr;
+         }
+         victim->block   = block;
+         victim->lastUse = shard.useCount;
+         return &victim->data;
+      } // lookupBlock
+
+      const uint8_t  *m_file      = (const uint8_t *) MAP_FAILED;
+      size_t          m_size      = 0;    // Size of file in bytes.
+      int             m_fd        = -1;
+      const Header   *m_header    = nullptr;
+      const uint64_t *m_offsets   = nullptr;
+      uint64_t        m_blockSize = 0;
+      uint64_t        m_tableSize = 0;    // Size of the uncompressed table in bytes.
+
+      mutable Shard   m_shards[cNumShards];
+
+}; // CompressedTableBase
+
+// A CompressedTableBase of the index scheme Index, which can be used in place
+// of a TableBase opened ReadOnly.
+template <typename Index>
+class CompressedTable : public CompressedTableBase
+{
+   public:
+      CompressedTable(const std::string& fileName, ssize_t numPositions, TableBase::Mode mode = TableBase::ReadOnly)
+         : CompressedTableBase(fileName, numPositions, Index::name(), Index::BoardType::cNumRows, Index::BoardType::cNumCols)
+      {
+         assert (mode == TableBase::ReadOnly);
+      }
+
+      // Open the file like the constructor, but return nullptr if it is not
+      // a good compressed database of the index scheme, instead of failing.
+      // See TableBase::tryOpen.
+      static std::unique_ptr<CompressedTable> tryOpen(const std::string& fileName, ssize_t numPositions) {
+         std::unique_ptr<CompressedTable> table(new CompressedTable());
+         if (!table->openFile(fileName, numPositions, Index::name(), Index::BoardType::cNumRows, Index::BoardType::cNumCols).empty()) {
+            return nullptr;
+         }
+         return table;
+      } // tryOpen
+
+   private:
+      CompressedTable()
+      {
+      }
+}; // CompressedTable
+
+#endif // _TOUCHDOWN_COMPRESSED_H
@@ -0,0 +1,81 @@
+#ifndef _TOUCHDOWN_DISTANCE_H
+#define _TOUCHDOWN_DISTANCE_H
+
+#include <string>
+#include <assert.h>
+#include "tablebase.h"
+
+// A distance table holds one byte for each index value, giving the number of
+// plies until the end of the game, when the winner plays the fastest win and
+// the loser the longest resistance. The byte value is the number of plies
+// plus one:
+//    0   : Unknown, i.e. an invalid index value or an illegal position.
+//    odd : A LOSS in value-1 plies. 1 is a position where the game is over.
+//    even: A WIN in value-1 plies.
+// So the game value can be read directly from the byte, without the
+// TableBase. Every move advances a pawn by one row, so a game can not last
+// longer than 2 * columns * (rows-1) plies, which fits in a byte for all the
+// supported board sizes.
+//
+// The table is stored next to the database, in a file named e.g.
+// "touchdown.tb.dtm". The bytes are held in a TableBase of 8 bits per index
+// value, so the table is generated in memory like the database (see the
+// Memory mode of TableBase), and written to the file by sync at the end. The
+// retrograde analysis writes the distance of each position when it resolves
+// the level of the position, so the table is all the memory it adds.
+class DistanceTable
+{
+   public:
+      static const uint8_t cUnknown = 0;
+      static const int     cMaxPlies = 254;
+
+      DistanceTable(const std::string& fileName, ssize_t numPositions, TableBase::Mode mode)
+         : m_table(fileName, 8 * numPositions, mode)
+      {
+      }
+
+      // Return the name of the distance table of a database.
+      static std::string fileName(const std::string& baseName) {
+         return baseName + ".dtm";
+      }
+
+      uint8_t read(uint64_t pos) const {
+         return m_table.data()[pos];
+      }
+
+      void write(uint64_t pos, uint8_t value) {
+         m_table.data()[pos] = value;
+      }
+
+      void prefetch(uint64_t pos) const {
+         __builtin_prefetch(&m_table.data()[pos]);
+      }
+
+      // Decode a byte value.
+      static bool isKnown(uint8_t value) { return value != cUnknown; }
+      static bool isWin(uint8_t value)   { return value != cUnknown && !(value & 1); }
+      static int  plies(uint8_t value)   { return value - 1; }
+
+      // Encode the value of a position, which is decided in the given number
+      // of plies. The value follows from the parity.
+      static uint8_t encode(int plies) {
+         assert (plies >= 0 && plies <= cMaxPlies);
+         return plies + 1;
+      }
+
+      // Reset all positions to unknown.
+      void clear() {
+         m_table.clear();
+      }
+
+      // Write the table to its file, see TableBase::sync.
+      void sync() {
+         m_table.sync();
+      }
+
+   private:
+      TableBase m_table;
+
+}; // DistanceTable
+
+#endif // _TOUCHDOWN_DISTANCE_H
@@ -2,35 +2,17 @@
 #include <iomanip>
 #include "index.h"
 
-// Take a binary value "ab" and return "ba"
-static unsigned int reverse2(unsigned int x)
-{
-   return ((x&1) << 1) | (x >> 1);
-}
-
-// Take a binary value "abcd" and return "dcba"
-static unsigned int reverse4(unsigned int x)
-{
-   return (reverse2(x & 3) << 2) | reverse2(x >> 2);
-}
+bool indexUseBmi2 = false;
 
-// Take a binary value "abcdefgh" and return "hgfedcba"
-static unsigned int reverse8(unsigned int x)
+void indexInit()
 {
-   return (reverse4(x & 0xF) << 4) | reverse4(x >> 4);
-}
-
-uint8_t indexReverse8Cache[0x100];
-
-// Pre-calculate the bit-reverse of all 8-bit numbers
-// and store in a 256-byte array.
-void indexReverseInit()
-{
-   for (unsigned int x=0; x<0x100; ++x)
-   {
-      indexReverse8Cache[x] = reverse8(x);
-   }
-} // void indexReverseInit()
+   // PEXT and PDEP are microcoded, and therefore very slow, on AMD CPUs
+   // before Zen 3. There the loops are faster.
+   __builtin_cpu_init();
+   indexUseBmi2 = __builtin_cpu_supports("bmi2")
+      && !__builtin_cpu_is("znver1")
+      && !__builtin_cpu_is("znver2");
+} // void indexInit()
 
 
 // This function counts the number of valid and invalid index vaules.
@@ -1,21 +1,91 @@
 #ifndef _TOUCHDOWN_INDEX_H
 #define _TOUCHDOWN_INDEX_H
 
-// This 256-byte array stores the bit-reverse of all 8-bit numbers.
-extern uint8_t indexReverse8Cache[0x100];
+#include <stdint.h>
+#include <immintrin.h>
 
-void indexReverseInit();
-   
-inline uint8_t indexReverse8(uint8_t x) { return indexReverse8Cache[x]; }
+// True if the CPU has fast BMI2 instructions (PEXT and PDEP). In that case
+// the bit gather and scatter below are single instructions.
+extern bool indexUseBmi2;
+
+// Detect the CPU features.
+void indexInit();
+
+// Reverse the order of the bits within each byte of x. With GFNI this is a
+// single affine transform of all 8 bytes. Otherwise neighbouring bits,
+// pairs, and nibbles are swapped with shifts and masks.
+inline uint64_t indexReverseBitsInBytes(uint64_t x) {
+#ifdef __GFNI__
+   __m128i reversed = _mm_gf2p8affine_epi64_epi8(_mm_cvtsi64_si128(x), _mm_set1_epi64x(0x8040201008040201), 0);
+   return _mm_cvtsi128_si64(reversed);
+#else
+   x = ((x >> 1) & 0x5555555555555555) | ((x & 0x5555555555555555) << 1);
+   x = ((x >> 2) & 0x3333333333333333) | ((x & 0x3333333333333333) << 2);
+   x = ((x >> 4) & 0x0F0F0F0F0F0F0F0F) | ((x & 0x0F0F0F0F0F0F0F0F) << 4);
+   return x;
+#endif
+}
+
+// The bit-reverse of a number is the bit-reverse of each byte, with the
+// order of the bytes reversed by the byte-swap instruction. There is no
+// lookup table, so the reverse does not wait for loads.
+inline uint8_t indexReverse8(uint8_t x) {
+   return (uint8_t) indexReverseBitsInBytes(x);
+}
 
 inline uint16_t indexReverse16(uint16_t x) { 
-   return (indexReverse8(x & 0xFF) << 8) | indexReverse8(x >> 8);
+   return __builtin_bswap16((uint16_t) indexReverseBitsInBytes(x));
 }
    
 inline uint32_t indexReverse32(uint32_t x) { 
-   return (indexReverse16(x & 0xFFFF) << 16) | indexReverse16(x >> 16);
+   return __builtin_bswap32((uint32_t) indexReverseBitsInBytes(x));
+}
+
+inline uint64_t indexReverse64(uint64_t x) { 
+   return __builtin_bswap64(indexReverseBitsInBytes(x));
 }
    
+// The BMI2 versions of indexExtractBits and indexDepositBits. These may
+// only be called when indexUseBmi2 is true.
+__attribute__((target("bmi2")))
+inline uint64_t indexExtractBitsBmi2(uint64_t x, uint64_t mask) {
+   return _pext_u64(x, mask);
+}
+
+__attribute__((target("bmi2")))
+inline uint64_t indexDepositBitsBmi2(uint64_t x, uint64_t mask) {
+   return _pdep_u64(x, mask);
+}
+
+// Gather the bits of x selected by mask into the low bits of the result.
+// E.g. indexExtractBits(0b1010, 0b1110) = 0b101.
+inline uint64_t indexExtractBits(uint64_t x, uint64_t mask) {
+   if (indexUseBmi2)
+      return indexExtractBitsBmi2(x, mask);
+
+   uint64_t result = 0;
+   for (uint64_t bit = 1; mask; bit *= 2) {
+      if (x & mask & -mask)
+         result |= bit;
+      mask &= mask - 1;
+   }
+   return result;
+}
+
+// Scatter the low bits of x to the bit positions selected by mask.
+// This is the inverse of indexExtractBits.
+inline uint64_t indexDepositBits(uint64_t x, uint64_t mask) {
+   if (indexUseBmi2)
+      return indexDepositBitsBmi2(x, mask);
+
+   uint64_t result = 0;
+   for (uint64_t bit = 1; mask; bit *= 2) {
+      if (x & bit)
+         result |= mask & -mask;
+      mask &= mask - 1;
+   }
+   return result;
+}
 
 // The index value of the board consists of a 16-bit string (in bits 15-0) and
 // an 8-bit string (in bits 23-16). 
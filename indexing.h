@@ -0,0 +1,366 @@
+#ifndef _TOUCHDOWN_INDEXING_H
+#define _TOUCHDOWN_INDEXING_H
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <string.h>
+#include "board.h"
+#include "index.h"
+#include "tablebase.h"
+
+// An index scheme numbers the board positions, so they can be stored in a
+// TableBase. Each scheme provides:
+//    size()       : The number of index values.
+//    isValid(i)   : Whether index value i corresponds to a board position.
+//    board(i)     : The board position of index value i.
+//    index(board) : The index value of a board position.
+//    name()       : A short name of the board size and scheme, e.g. "4x4".
+//    weight(board): The number of positions the index value of board stands
+//                   for, i.e. 2 if it also stands for the mirror image.
+//    cMirrored    : Whether a position and its mirror image share an index
+//                   value.
+//    forEachValid(begin, end, func) :
+//                   Call func(i) for each valid index value i in [begin, end),
+//                   in increasing order, without visiting the invalid ones.
+//                   The range is typically a chunk of parallelFor.
+//    fillInvalid(tb): Set the game value of all invalid index values to WIN.
+// The board positions include illegal positions (where isWin() is true) for
+// some schemes but not for others.
+
+// Board sizes are named by the number of columns and rows, e.g. "6x4" is a
+// board with six columns and four rows.
+inline std::string boardName(int numRows, int numCols) {
+   return std::to_string(numCols) + "x" + std::to_string(numRows);
+}
+
+// The 24-bit index value described in index.h. Most index values are
+// invalid. This is only defined for the 4x4 board.
+//
+// The valid index values are enumerated directly. An index value consists of
+// the player pawns c (the upper 8 bits) and the occupied squares b (the lower
+// 16 bits), and according to indexIsValid it is valid if c has at most four
+// bits, and the number of bits of b is between the bit length of c and the
+// number of bits of c plus four. So for each c, the valid values of b are a
+// precomputed sorted list, which only depends on that range of bit counts.
+template <int tNumRows, int tNumCols>
+struct SparseIndex
+{
+   typedef Board<tNumRows, tNumCols> BoardType;
+
+   static uint64_t size() { return g_numPositions; }
+   static bool isValid(uint64_t index) { return indexIsValid(index); }
+   static BoardType board(uint64_t index) { return BoardType((uint32_t) index); }
+   static uint64_t index(const BoardType& board) { return board.getIndex(); }
+   static std::string name() { return boardName(tNumRows, tNumCols); }
+   static int weight(const BoardType&) { return 1; }
+   static const bool cMirrored = false;
+
+   template <typename Func>
+   static void forEachValid(uint64_t begin, uint64_t end, Func func) {
+      const Table& t = table();
+      for (uint64_t c = begin >> 16; c < 0x100 && (c << 16) < end; ++c) {
+         if (t.m_range[c] < 0) {
+            continue;
+         }
+         const std::vector<uint16_t>& occupied = t.m_occupied[t.m_range[c]];
+         uint64_t base = c << 16;
+
+         auto it = occupied.begin();
+         if (begin > base) {
+            it = std::lower_bound(occupied.begin(), occupied.end(), begin - base);
+         }
+         for (; it != occupied.end() && base + *it < end; ++it) {
+            func(base + *it);
+         }
+      }
+   } // forEachValid
+
+   // The 8 kB of the table for each c are copied from a precomputed bitmap.
+   static void fillInvalid(TableBase& tb) {
+      const Table& t = table();
+      for (int c = 0; c < 0x100; ++c) {
+         uint8_t *bytes = tb.data() + c * 0x2000;
+         if (t.m_range[c] < 0) {
+            memset(bytes, 0xFF, 0x2000);
+         } else {
+            for (int i = 0; i < 0x2000; ++i) {
+               bytes[i] |= t.m_invalid[t.m_range[c]][i];
+            }
+         }
+      }
+   } // fillInvalid
+
+   private:
+   // The tables are calculated once, on first use.
+   struct Table {
+      Table() {
+         static_assert(BoardType::cNumSquares == 16, "The 24-bit index is only defined for the 4x4 board");
+
+         for (int c = 0; c < 0x100; ++c) {
+            int minCount = c ? 32 - __builtin_clz(c) : 0;   // Bit length of c.
+            int maxCount = __builtin_popcount(c) + 4;
+            if (__builtin_popcount(c) > 4) {
+               m_range[c] = -1;
+               continue;
+            }
+
+            // Reuse the list of an earlier c with the same range.
+            m_range[c] = -1;
+            for (size_t r = 0; r < m_occupied.size(); ++r) {
+               if (m_minCount[r] == minCount && m_maxCount[r] == maxCount) {
+                  m_range[c] = r;
+               }
+            }
+            if (m_range[c] >= 0) {
+               continue;
+            }
+
+            m_range[c] = m_occupied.size();
+            m_minCount.push_back(minCount);
+            m_maxCount.push_back(maxCount);
+            m_occupied.emplace_back();
+            m_invalid.emplace_back(0x2000, 0xFF);
+            for (uint32_t b = 0; b < 0x10000; ++b) {
+               int count = __builtin_popcount(b);
+               if (count >= minCount && count <= maxCount) {
+                  m_occupied.back().push_back(b);
+                  m_invalid.back()[b/8] &= ~(1 << (b%8));
+               }
+            }
+         }
+      }
+
+      int m_range[0x100];                              // List used for each c, or -1 if none is valid.
+      std::vector<int> m_minCount;                     // The range of bit counts of each list.
+      std::vector<int> m_maxCount;
+      std::vector<std::vector<uint16_t>> m_occupied;   // The valid values of b, in increasing order.
+      std::vector<std::vector<uint8_t>>  m_invalid;    // Bitmap of the invalid values of b.
+   }; // Table
+
+   static const Table& table() {
+      static const Table s_table;
+      return s_table;
+   }
+}; // SparseIndex
+
+// The rank value described in rank.h. All rank values are valid, and
+// correspond to legal positions.
+template <int tNumRows, int tNumCols>
+struct RankIndex
+{
+   typedef Board<tNumRows, tNumCols> BoardType;
+
+   static uint64_t size() { return Rank<tNumRows, tNumCols>::size(); }
+   static bool isValid(uint64_t) { return true; }
+   static BoardType board(uint64_t index) { return BoardType::fromRank(index); }
+   static uint64_t index(const BoardType& board) { return board.getRank(); }
+   static std::string name() { return boardName(tNumRows, tNumCols) + "r"; }
+   static int weight(const BoardType&) { return 1; }
+   static const bool cMirrored = false;
+
+   template <typename Func>
+   static void forEachValid(uint64_t begin, uint64_t end, Func func) {
+      for (uint64_t index = begin; index < end; ++index) {
+         func(index);
+      }
+   }
+
+   static void fillInvalid(TableBase&) {}
+}; // RankIndex
+
+// The rank value described in rank.h, but with the positions reduced by the
+// left-right mirror symmetry of the game. A position and its mirror image
+// have the same game value, so only the canonical one of the two (see
+// Board::getCanonical) is stored, and index() maps both to it.
+//
+// Within each material class, the player pawn placements are restricted to
+// the canonical ones, i.e. those that are not larger than their mirror image.
+// These are numbered in increasing order, which takes a table per number of
+// player pawns. The opponent placements are numbered as by the rank index.
+// If the player pawns are symmetric, the opponent placement decides which
+// position is canonical, so the index values of the other half of these
+// positions are invalid. This roughly halves the number of index values.
+template <int tNumRows, int tNumCols>
+struct MirrorIndex
+{
+   typedef Board<tNumRows, tNumCols> BoardType;
+   typedef Rank<tNumRows, tNumCols>  RankType;
+
+   static const int cNumPawns = BoardType::cNumPawns;
+
+   static uint64_t size() { return table().m_offset[cNumPawns+1][0]; }
+
+   static bool isValid(uint64_t index) {
+      BoardType b = board(index);
+      return b.getCanonical().getPosition() == b.getPosition();
+   }
+
+   static BoardType board(uint64_t index) {
+      const Table& t = table();
+      assert (index < size());
+
+      // Find the material class.
+      int numPlayer   = 0;
+      int numOpponent = 1;
+      while (t.m_offset[numPlayer+1][0] <= index) {
+         ++numPlayer;
+      }
+      while (numOpponent < cNumPawns && t.m_offset[numPlayer][numOpponent] <= index) {
+         ++numOpponent;
+      }
+      index -= t.m_offset[numPlayer][numOpponent-1];
+
+      uint64_t numOpponentPlacements = RankType::binomial(BoardType::cNumSquares-numPlayer, numOpponent);
+      uint64_t player   = t.m_player[numPlayer][index / numOpponentPlacements];
+      uint64_t opponent = indexDepositBits(RankType::unrankSubset(index % numOpponentPlacements, numOpponent),
+                                           BoardType::cAllSquares & ~player);
+
+      BoardType board;
+      board.setPosition(BoardType::makePosition(player, opponent));
+      return board;
+   } // board
+
+   static uint64_t index(const BoardType& board) {
+      assert (!board.isWin());
+      BoardType canonical = board.getCanonical();
+
+      uint64_t player      = canonical.getPlayer();
+      uint64_t opponent    = canonical.getOpponent();
+      int      numPlayer   = __builtin_popcountll(player);
+      int      numOpponent = __builtin_popcountll(opponent);
+
+      const Table& t = table();
+      uint64_t rankPlayer   = t.m_playerNumber[numPlayer][RankType::rankSubset(player >> tNumCols)];
+      uint64_t rankOpponent = RankType::rankSubset(indexExtractBits(opponent, BoardType::cAllSquares & ~player));
+
+      return t.m_offset[numPlayer][numOpponent-1]
+         + rankPlayer * RankType::binomial(BoardType::cNumSquares-numPlayer, numOpponent) + rankOpponent;
+   } // index
+
+   static std::string name() { return boardName(tNumRows, tNumCols) + "m"; }
+
+   static int weight(const BoardType& board) { return board.isSymmetric() ? 1 : 2; }
+
+   static const bool cMirrored = true;
+
+   // The valid index values are enumerated directly, without building the
+   // boards. All opponent placements of a player placement that is smaller
+   // than its mirror image are valid, and those of a symmetric one are valid
+   // if the opponent placement is not larger than its mirror image.
+   template <typename Func>
+   static void forEachValid(uint64_t begin, uint64_t end, Func func) {
+      forEachRun(begin, end, [&](uint64_t index, uint64_t count, uint64_t player, int numOpponent, uint64_t rankOpponent) {
+         if (BoardType::mirrorSquares(player) != player) {
+            for (uint64_t i = index; i < index + count; ++i) {
+               func(i);
+            }
+            return;
+         }
+         forEachOpponent(index, count, player, numOpponent, rankOpponent, [&](uint64_t i, uint64_t opponent) {
+            if (BoardType::mirrorSquares(opponent) >= opponent) {
+               func(i);
+            }
+         });
+      });
+   } // forEachValid
+
+   // Only the runs of the symmetric player placements hold invalid index
+   // values, so the others are skipped as a whole.
+   static void fillInvalid(TableBase& tb) {
+      forEachRun(0, size(), [&](uint64_t index, uint64_t count, uint64_t player, int numOpponent, uint64_t rankOpponent) {
+         if (BoardType::mirrorSquares(player) != player) {
+            return;
+         }
+         forEachOpponent(index, count, player, numOpponent, rankOpponent, [&](uint64_t i, uint64_t opponent) {
+            if (BoardType::mirrorSquares(opponent) < opponent) {
+               tb.setBit(i, true);
+            }
+         });
+      });
+   } // fillInvalid
+
+   private:
+   // Split [begin, end) into runs of index values with the same material
+   // class and player placement, and call
+   // func(index, count, player, numOpponent, rankOpponent) for each, where
+   // the run [index, index+count) starts at the opponent placement with the
+   // rank rankOpponent.
+   template <typename Func>
+   static void forEachRun(uint64_t begin, uint64_t end, Func func) {
+      const Table& t = table();
+      end = std::min(end, size());
+      for (int np=0; np<=cNumPawns; ++np) {
+         for (int no=1; no<=cNumPawns; ++no) {
+            uint64_t numOpponentPlacements = RankType::binomial(BoardType::cNumSquares-np, no);
+            uint64_t classBegin = t.m_offset[np][no-1];
+            uint64_t classEnd   = std::min(end, classBegin + t.m_player[np].size() * numOpponentPlacements);
+            for (uint64_t index = std::max(begin, classBegin); index < classEnd; ) {
+               uint64_t rankPlayer   = (index - classBegin) / numOpponentPlacements;
+               uint64_t rankOpponent = (index - classBegin) % numOpponentPlacements;
+               uint64_t count = std::min(numOpponentPlacements - rankOpponent, classEnd - index);
+               func(index, count, t.m_player[np][rankPlayer], no, rankOpponent);
+               index += count;
+            }
+         }
+      }
+   } // forEachRun
+
+   // Call func(index, opponent) for the opponent placements of a run, see
+   // forEachRun. The subsets of the free squares are visited in the order of
+   // their rank, which is increasing as numbers, so each follows from the
+   // previous one without unranking it.
+   template <typename Func>
+   static void forEachOpponent(uint64_t index, uint64_t count, uint64_t player, int numOpponent,
+                               uint64_t rankOpponent, Func func) {
+      uint64_t freeSquares = BoardType::cAllSquares & ~player;
+      uint64_t subset      = RankType::unrankSubset(rankOpponent, numOpponent);
+      for (uint64_t i = 0; i < count; ++i) {
+         func(index + i, indexDepositBits(subset, freeSquares));
+
+         // The next larger number with the same number of bits.
+         uint64_t lowest = subset & -subset;
+         uint64_t ripple = subset + lowest;
+         subset = (((ripple ^ subset) >> 2) / lowest) | ripple;
+      }
+   } // forEachOpponent
+
+   // The tables are calculated once, on first use.
+   struct Table {
+      Table() {
+         for (int np=0; np<=cNumPawns; ++np) {
+            uint64_t numPlacements = RankType::binomial(RankType::cNumPlayerSquares, np);
+            m_playerNumber[np].resize(numPlacements);
+            for (uint64_t rank=0; rank<numPlacements; ++rank) {
+               uint64_t player = RankType::unrankSubset(rank, np) << tNumCols;
+               m_playerNumber[np][rank] = m_player[np].size();
+               if (BoardType::mirrorSquares(player) >= player) {
+                  m_player[np].push_back(player);
+               }
+            }
+         }
+
+         // m_offset[np][no-1] is the first index value with np player pawns
+         // and no opponent pawns, as in rank.h.
+         uint64_t offset = 0;
+         for (int np=0; np<=cNumPawns; ++np) {
+            for (int no=1; no<=cNumPawns; ++no) {
+               m_offset[np][no-1] = offset;
+               offset += m_player[np].size() * RankType::binomial(BoardType::cNumSquares-np, no);
+            }
+         }
+         m_offset[cNumPawns+1][0] = offset;
+      }
+
+      std::vector<uint64_t> m_player[cNumPawns+1];         // Canonical player placements, in increasing order.
+      std::vector<uint32_t> m_playerNumber[cNumPawns+1];   // Number of each canonical placement, by its rank.
+      uint64_t m_offset[cNumPawns+2][cNumPawns] = {};
+   }; // Table
+
+   static const Table& table() {
+      static const Table s_table;
+      return s_table;
+   }
+}; // MirrorIndex
+
+#endif // _TOUCHDOWN_INDEXING_H
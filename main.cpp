@@ -1,33 +1,48 @@
 #include <iostream>
 #include <iomanip>
 #include <bitset>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <chrono>
+#include <mutex>
+#include <atomic>
 #include <unistd.h>
+#include <getopt.h>
 #include "tablebase.h"
 #include "board.h"
 #include "index.h"
-
-const int cNumRows = 4;
-const int cNumCols = 4;
+#include "indexing.h"
+#include "parallel.h"
+#include "slice.h"
+#include "movegen.h"
+#include "server.h"
+#include "distance.h"
+#include "npy.h"
+#include "compressed.h"
+#include "checkpoint.h"
+#include "stats.h"
+#include "statetable.h"
+#include "search.h"
+#include "perft.h"
 
 
+template <typename Index>
 static void dumpAllValidIndices()
 {
-    for (uint32_t index = 0; index < 0x01000000; ++index) {
-        if (!indexIsValid(index)) {
-            continue;
-        }
+    Index::forEachValid(0, Index::size(), [&](uint64_t index) {
         std::cout << std::hex << std::setfill('0') << std::setw(6) << index << std::endl;
-    }
+    });
 } // dumpAllValidIndices
 
+template <typename Index>
 static void dumpAllLegalBoards()
 {
-    for (uint32_t index = 0; index < 0x01000000; ++index) {
-        if (!indexIsValid(index)) {
-            continue;
-        }
-        Board<cNumRows, cNumCols> board(index);
-        assert (board.getIndex() == index);
+    Index::forEachValid(0, Index::size(), [&](uint64_t index) {
+        typename Index::BoardType board = Index::board(index);
+        assert (Index::index(board) == index);
 
         std::cout << std::hex << std::setfill('0') << std::setw(6) << index << " : " << board.toShortString() << " ";
         if (board.isWin())
@@ -36,32 +51,44 @@ static void dumpAllLegalBoards()
             std::cout << "LOSS" << std::endl;
         else 
             std::cout << std::endl;
-    }
+    });
 } // dumpAllLegalBoards
 
+// Write a board representation as a hexadecimal number. The stream
+// manipulators apply to the most significant 64 bits.
+template <typename Position>
+static void writePosition(std::ostream& os, Position position)
+{
+    if (sizeof(Position) > sizeof(uint64_t)) {
+        os << (uint64_t) (position >> 32 >> 32);
+        os << std::setw(16) << std::setfill('0') << (uint64_t) position << std::setfill(' ');
+    } else {
+        os << (uint64_t) position;
+    }
+} // writePosition
+
 // Dump database to output
+template <typename Index, typename Table>
 static void dumpDatabase(const char *filename)
 {
-    TableBase tb(filename);
+    Table tb(filename, Index::size(), TableBase::ReadOnly);
 
     // Loop over all positions.
-    for (uint32_t index = 0; index < 0x01000000; ++index) {
-        // First check if index is valid
-        if (!indexIsValid(index)) {
-            continue;
-        }
+    Index::forEachValid(0, Index::size(), [&](uint64_t index) {
 
         // Now construct the board
-        Board<cNumRows, cNumCols> board(index);
+        typename Index::BoardType board = Index::board(index);
 
         // If the position is a WIN, then this is an illegal position.
         if (board.isWin()) {
-            continue;
+            return;
         }
 
         std::cout << std::setw(6) << std::hex << index << std::dec << " : ";
         std::cout << board.toShortString() << " : ";
-        std::cout << std::setw(8) << std::hex << board.getPosition() << " " << std::dec;
+        std::cout << std::setw(8) << std::hex;
+        writePosition(std::cout, board.getPosition());
+        std::cout << " " << std::dec;
 
         // Skip positions that are unknown
         if (tb.readBit(index)) {
@@ -69,80 +96,181 @@ static void dumpDatabase(const char *filename)
         } else {
             std::cout << "LOSS" << std::endl;
         }
-    }
+    });
 } // dumpDatabase
 
 // Dump database to output
+template <typename Index, typename Table>
 static void outputDatabase(const char *filename)
 {
-    TableBase tb(filename);
+    Table tb(filename, Index::size(), TableBase::ReadOnly);
 
     // Loop over all positions.
-    for (uint32_t index = 0; index < 0x01000000; ++index) {
-        // First check if index is valid
-        if (!indexIsValid(index)) {
-            continue;
-        }
+    Index::forEachValid(0, Index::size(), [&](uint64_t index) {
 
         // Now construct the board
-        Board<cNumRows, cNumCols> board(index);
+        typename Index::BoardType board = Index::board(index);
 
         // If the position is a WIN, then this is an illegal position.
         if (board.isWin()) {
-            continue;
+            return;
         }
 
-        uint32_t position = board.getPosition();
-        uint16_t player   = position & (position >> 16);
-        uint16_t opponent = position & (~(position >> 16));
-        uint32_t val      = (opponent << 16) | player;
+        uint64_t player   = board.getPlayer();
+        uint64_t opponent = board.getOpponent();
 
-        for (int i=0; i<32; ++i) {
-            std::cout << (val&1) << " ";
-            val /= 2;
+        for (int i=0; i<Index::BoardType::cNumSquares; ++i) {
+            std::cout << (player&1) << " ";
+            player /= 2;
+        }
+        for (int i=0; i<Index::BoardType::cNumSquares; ++i) {
+            std::cout << (opponent&1) << " ";
+            opponent /= 2;
         }
 
         // Skip positions that are unknown
         if (tb.readBit(index)) {
-            std::cout << "  1 0" << std::endl;
+            std::cout << "  1 0\n";
         } else {
-            std::cout << "  0 1" << std::endl;
+            std::cout << "  0 1\n";
         }
-    }
+    });
 } // outputDatabase
 
+// Export the database as training data, in NumPy .npy files (see npy.h):
+// * <filename>.train.x.npy holds the features of each legal position, as an
+//   array of bytes with one row per position. The first cNumSquares bits are
+//   the player pawns, and the next cNumSquares bits are the opponent pawns,
+//   with the first bit in the least significant bit of the first byte. They
+//   are unpacked by numpy.unpackbits(x, axis=1, bitorder='little').
+// * <filename>.train.y.npy holds the labels, 1 for WIN and 0 for LOSS.
+// If validationPercent is non-zero, that percentage of the positions are
+// written to <filename>.valid.x.npy and <filename>.valid.y.npy instead.
+//
+// The positions are in index order, unless seed is non-zero, in which case
+// they are shuffled with that seed. With the mirror index, both a position
+// and its mirror image are written. The positions are split into chunks, and
+// each thread writes its chunks directly to their place in the files.
+template <typename Index, typename Table>
+static void exportDatabase(const char *filename, uint64_t seed, int validationPercent, int numThreads)
+{
+    typedef typename Index::BoardType BoardType;
+    const int      cNumBytes  = (2 * BoardType::cNumSquares + 7) / 8;
+    const uint64_t cChunkSize = 0x10000;
+
+    Table tb(filename, Index::size(), TableBase::ReadOnly);
+
+    // Count the positions of each chunk, to find where each chunk starts.
+    uint64_t numChunks = (Index::size() + cChunkSize - 1) / cChunkSize;
+    std::vector<uint64_t> chunkStart(numChunks + 1);
+    parallelFor(numThreads, Index::size(), cChunkSize, [&](int, uint64_t begin, uint64_t end) {
+        uint64_t count = 0;
+        Index::forEachValid(begin, end, [&](uint64_t index) {
+            BoardType board = Index::board(index);
+            if (!board.isWin()) {
+                count += Index::weight(board);
+            }
+        });
+        chunkStart[begin / cChunkSize + 1] = count;
+    });
+    std::partial_sum(chunkStart.begin(), chunkStart.end(), chunkStart.begin());
+    const uint64_t numSamples = chunkStart[numChunks];
+
+    // The row of the files, that each position is written to.
+    std::vector<uint64_t> shuffled;
+    if (seed) {
+        shuffled.resize(numSamples);
+        std::iota(shuffled.begin(), shuffled.end(), 0);
+        std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937_64(seed));
+    }
+
+    const uint64_t numValid = numSamples * validationPercent / 100;
+    const uint64_t numTrain = numSamples - numValid;
+
+    NpyFile trainX(std::string(filename) + ".train.x.npy", numTrain, cNumBytes);
+    NpyFile trainY(std::string(filename) + ".train.y.npy", numTrain);
+    std::unique_ptr<NpyFile> validX;
+    std::unique_ptr<NpyFile> validY;
+    if (numValid) {
+        validX.reset(new NpyFile(std::string(filename) + ".valid.x.npy", numValid, cNumBytes));
+        validY.reset(new NpyFile(std::string(filename) + ".valid.y.npy", numValid));
+    }
+
+    parallelFor(numThreads, Index::size(), cChunkSize, [&](int, uint64_t begin, uint64_t end) {
+        uint64_t sample = chunkStart[begin / cChunkSize];
+
+        auto writeSample = [&](const BoardType& board, bool isWin) {
+            uint64_t row = seed ? shuffled[sample] : sample;
+            ++sample;
+
+            NpyFile *x = &trainX;
+            NpyFile *y = &trainY;
+            if (row >= numTrain) {
+                row -= numTrain;
+                x = validX.get();
+                y = validY.get();
+            }
+
+            unsigned __int128 bits = board.getPlayer() | ((unsigned __int128) board.getOpponent() << BoardType::cNumSquares);
+            uint8_t *features = x->data() + row * cNumBytes;
+            for (int i=0; i<cNumBytes; ++i) {
+                features[i] = (uint8_t) (bits >> (8*i));
+            }
+            y->data()[row] = isWin;
+        }; // writeSample
+
+        Index::forEachValid(begin, end, [&](uint64_t index) {
+            // Now construct the board
+            BoardType board = Index::board(index);
+
+            // If the position is a WIN, then this is an illegal position.
+            if (board.isWin()) {
+                return;
+            }
+
+            bool isWin = tb.readBit(index);
+            writeSample(board, isWin);
+            if (Index::weight(board) == 2) {
+                writeSample(board.getMirror(), isWin);
+            }
+        });
+    });
+
+    std::cout << "Training samples   : " << numTrain << std::endl;
+    std::cout << "Validation samples : " << numValid << std::endl;
+} // exportDatabase
+
+template <typename Index, typename Table>
 static void summarizeDatabase(const char *filename)
 {
-    TableBase tb(filename);
+    Table tb(filename, Index::size(), TableBase::ReadOnly);
 
     // Loop over all positions.
-    uint32_t cnt_invalid_index = 0;
-    uint32_t cnt_illegal_board = 0;
-    uint32_t cnt_win           = 0;
-    uint32_t cnt_loss          = 0;
-    for (uint32_t index = 0; index < 0x01000000; ++index) {
-        // First check if index is valid
-        if (!indexIsValid(index)) {
-            cnt_invalid_index++;
-            continue;
-        }
+    uint64_t cnt_invalid_index = 0;
+    uint64_t cnt_illegal_board = 0;
+    uint64_t cnt_win           = 0;
+    uint64_t cnt_loss          = 0;
+    uint64_t cnt_valid_index   = 0;
+    Index::forEachValid(0, Index::size(), [&](uint64_t index) {
+        cnt_valid_index++;
 
         // Now construct the board
-        Board<cNumRows, cNumCols> board(index);
+        typename Index::BoardType board = Index::board(index);
 
         // If the position is a WIN, then this is an illegal position.
         if (board.isWin()) {
             cnt_illegal_board++;
-            continue;
+            return;
         }
 
-        // Skip positions that are unknown
+        // With the mirror index, most index values stand for two positions.
         if (tb.readBit(index)) {
-            cnt_win++;
+            cnt_win += Index::weight(board);
         } else {
-            cnt_loss++;
+            cnt_loss += Index::weight(board);
         }
-    }
+    });
+    cnt_invalid_index = Index::size() - cnt_valid_index;
 
     std::cout << std::endl;
     std::cout << "Dump of statistics"   << std::endl;
@@ -155,104 +283,947 @@ static void summarizeDatabase(const char *filename)
 
 } // static void summarizeDatabase(const char *filename)
 
+// Verify an existing database, without generating it again. Each legal
+// position must be a LOSS if the game is already lost, and otherwise a WIN
+// exactly if one of its moves leads to a LOSS for the opponent. This checks
+// every position against its successors, so a single wrong value is found,
+// whether it comes from the generation, or from copying or decompressing the
+// file. A position in a damaged block of a compressed database, or with a
+// successor in one, is a mismatch too. The positions are checked in chunks by
+// numThreads threads, which report their throughput. The mismatches with the
+// lowest index values are printed. Returns true if there are none.
+template <typename Index, typename Table>
+static bool verifyDatabase(const char *filename, int numThreads)
+{
+    typedef typename Index::BoardType BoardType;
+    typedef std::chrono::steady_clock Clock;
+    const uint64_t cChunkSize     = 0x10000;
+    const size_t   cMaxMismatches = 10;
+
+    Table tb(filename, Index::size(), TableBase::ReadOnly);
+
+    struct ThreadStats {
+        uint64_t positions = 0;
+        double   seconds   = 0;
+    };
+    std::vector<ThreadStats> threadStats(std::max(numThreads, 1));
+    std::atomic<uint64_t> numMismatches(0);
+    std::vector<uint64_t> mismatches;
+    std::mutex mismatchMutex;
+
+    // Return the value of a legal position, that follows from the values of
+    // its successors, or -1 if a successor is in a damaged block.
+    auto expectedValue = [&](const BoardType& board) {
+        if (board.isLoss()) {
+            return 0;
+        }
+        typename BoardType::Position legalMoves[BoardType::cMaxMoves];
+        uint64_t moveIndices[BoardType::cMaxMoves];
+        int moveCount = board.writeLegalMoves(legalMoves);
+        for (int i = 0; i < moveCount; ++i) {
+            BoardType child;
+            child.setPosition(legalMoves[i]);
+            moveIndices[i] = Index::index(child);
+            tb.prefetch(moveIndices[i]);
+        }
+        for (int i = 0; i < moveCount; ++i) {
+            int childValue = tb.tryReadBit(moveIndices[i]);
+            if (childValue <= 0) {
+                return childValue < 0 ? -1 : 1;
+            }
+        }
+        return 0;
+    };
+
+    Clock::time_point start = Clock::now();
+    parallelFor(numThreads, Index::size(), cChunkSize, [&](int threadNum, uint64_t begin, uint64_t end) {
+        Clock::time_point chunkStart = Clock::now();
+        uint64_t positions = 0;
+        Index::forEachValid(begin, end, [&](uint64_t index) {
+            BoardType board = Index::board(index);
+            if (board.isWin()) {
+                return;
+            }
+            ++positions;
+
+            int value = tb.tryReadBit(index);
+            int expected = expectedValue(board);
+            if (value < 0 || expected < 0 || value != expected) {
+                ++numMismatches;
+                // Only keep the mismatches with the lowest index values.
+                std::lock_guard<std::mutex> lock(mismatchMutex);
+                mismatches.push_back(index);
+                if (mismatches.size() >= 2 * cMaxMismatches) {
+                    std::sort(mismatches.begin(), mismatches.end());
+                    mismatches.resize(cMaxMismatches);
+                }
+            }
+        });
+        threadStats[threadNum].positions += positions;
+        threadStats[threadNum].seconds   += std::chrono::duration<double>(Clock::now() - chunkStart).count();
+    });
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::sort(mismatches.begin(), mismatches.end());
+    for (size_t i = 0; i < mismatches.size() && i < cMaxMismatches; ++i) {
+        BoardType board = Index::board(mismatches[i]);
+        int value = tb.tryReadBit(mismatches[i]);
+        int expected = expectedValue(board);
+        std::cout << "Mismatch at index " << mismatches[i] << " : " << board.toShortString()
+                  << (value < 0 ? " is in a damaged block" :
+                      expected < 0 ? " has a successor in a damaged block" :
+                      value ? " is WIN, should be LOSS" : " is LOSS, should be WIN") << std::endl;
+    }
+
+    uint64_t total = 0;
+    for (size_t i = 0; i < threadStats.size(); ++i) {
+        const ThreadStats& stats = threadStats[i];
+        total += stats.positions;
+        std::cout << "Thread " << i << " : " << stats.positions << " positions, "
+                  << std::fixed << std::setprecision(3) << stats.seconds << " s, "
+                  << (uint64_t) (stats.seconds > 0 ? stats.positions / stats.seconds : 0) << " positions/s" << std::endl;
+    }
+    std::cout << "Verified " << total << " positions in " << std::fixed << std::setprecision(3) << seconds << " s, "
+              << numMismatches << " mismatches" << std::endl;
+    return numMismatches == 0;
+} // verifyDatabase
+
 // The algorithm used performs multiple loops over all legal - but still
 // unknown - positions.  For each position, it tries all legal moves. If all
 // legal moves leads to currently known positions, then this position is
 // considered known too, and the database is updated.
-static void generateDatabase(const char *filename)
+//
+// The state of each position (see statetable.h) is kept in a StateTable,
+// and the database is written from it at the end.
+//
+// Each loop is split into chunks of positions, which are processed by
+// numThreads worker threads. The state table is shared between the threads,
+// so all accesses use the atomic versions of read and set. The order in
+// which positions become known may vary, but the final database does not.
+//
+// If checkpointInterval is non-zero, a checkpoint (see checkpoint.h) of the
+// state table is written after a loop, when at least that many seconds have passed
+// since the previous one. If resume is set, the generation continues from the
+// last checkpoint, if there is one.
+//
+// The statistics of each loop (see stats.h) are written to standard output,
+// and to the file statsFileName as JSON, if it is given.
+template <typename Index>
+static void generateDatabase(const char *filename, int numThreads, int checkpointInterval, bool resume,
+        const char *statsFileName)
 {
-    // The initial values of the tablebase is that all positions are unknown.
-    TableBase tb(filename);
-    TableBase known("/tmp/touchdown.known");
+    StateTable state(Index::size());
 
-    bool updated = true;
+    const uint32_t cChunkSize = 0x10000;
+
+    Checkpoint checkpoint(filename, Index::name(), Index::size());
+    std::vector<uint64_t> noValues;
+    uint64_t pass = 0;
+    if (resume && checkpoint.restore(pass, {&state.table()}, noValues)) {
+        std::cout << "Resuming after pass " << pass << std::endl;
+    } else {
+        // Initially all positions are unknown. All invalid indices are
+        // marked, and are not visited at all.
+        state.clear();
+        state.fillInvalid<Index>();
+    }
+    std::chrono::steady_clock::time_point lastCheckpoint = std::chrono::steady_clock::now();
+
+    PassStats stats(statsFileName, {{"state", &state.table()}});
+
+    std::atomic<bool> updated(true);
     // Repeat as long as the database is updated.
     while (updated) {
         updated = false; // Assume no more updates.
 
-        std::cout << "." << std::flush;  // Output current progress.
+        PassCounters passCounters;
 
         // Loop over all positions.
-        for (uint32_t index = 0; index < 0x01000000; ++index) {
+        parallelFor(numThreads, Index::size(), cChunkSize, [&](int, uint64_t begin, uint64_t end) {
+            bool chunkUpdated = false;
+            PassCounters counters;
 
-            // Skip positions that are already known
-            if (known.readBit(index)) {
-                continue;
-            }
+            // The positions that are not terminal are collected in batches,
+            // and the legal moves are generated for a batch at a time.
+            MoveBatch<typename Index::BoardType> batch;
+
+            // Now we loop over all legal moves of each position in the batch
+            // IF any successor leads to an unknown position, then this position is unknown too.
+            // If any successor leads to a LOSS (for the opponent), then this position is a WIN.
+            // If all successors lead to a WIN (for the opponent), then this position is a LOSS.
+            // If no successor available, then this position is a LOSS.
+            auto evaluateBatch = [&]() {
+                batch.generate();
+
+                for (int b=0; b<batch.count(); ++b) {
+                    bool isKnown = true;    // Assume position is known.
+                    bool isWin   = false;   // Assume position is a LOSS, e.g. if no successors.
+
+                    typename Index::BoardType board;
+                    typename Index::BoardType::Position legalMoves[Index::BoardType::cMaxMoves];
+                    int moveCount = batch.writeLegalMoves(b, board, legalMoves);
+
+                    // Loop over all squares
+                    for (int i=0; i<moveCount; ++i) {
+                        board.setPosition(legalMoves[i]);
+                        uint64_t newIndex = Index::index(board);
+                        counters.probed.add();
 
-            // First check if index is valid
-            if (!indexIsValid(index)) {
-                known.setBit(index, true);
-                tb.setBit(index, true); // All invalid indices are given the game value WIN.
+                        StateTable::State childState = state.readAtomic(newIndex);
+                        if (childState == StateTable::Unknown)
+                        {
+                            // If one child is unknown, then we can stop immediately.
+                            isKnown = false;
+                            counters.exitUnknown.add();
+                            break;
+                        }
+                        if (childState == StateTable::Loss)
+                        {
+                            // If one child is lost, then we are winning, and can stop immediately.
+                            isWin = true;
+                            counters.exitWin.add();
+                            break;
+                        }
+                    } // end for
+
+                    if (isKnown) {
+                        state.setAtomic(batch.index(b), isWin ? StateTable::Win : StateTable::Loss);
+                        chunkUpdated = true;
+                        (isWin ? counters.resolvedWin : counters.resolvedLoss).add();
+                    }
+                } // for
+
+                batch.clear();
+            }; // evaluateBatch
+
+            // Only the positions that are still unknown are visited.
+            state.forEachUnknown(begin, end, [&](uint64_t index) {
+                counters.visited.add();
+
+                // Now construct the board
+                typename Index::BoardType board = Index::board(index);
+
+                // If the position is a WIN, then this is an illegal position.
+                if (board.isWin()) {
+                    state.setAtomic(index, StateTable::Win); // All illegal board positions are given the game value WIN.
+                    chunkUpdated = true;
+                    return;
+                }
+
+                // If the position is a LOSS, then we're done with this position.
+                if (board.isLoss()) {
+                    state.setAtomic(index, StateTable::Loss); // This position is a LOSS.
+                    chunkUpdated = true;
+                    counters.resolvedLoss.add();
+                    return;
+                }
+
+                if (batch.add(index, board.getPosition())) {
+                    evaluateBatch();
+                }
+            }); // forEachUnknown
+
+            evaluateBatch();
+
+            if (chunkUpdated) {
                 updated = true;
-                continue;
             }
+            passCounters.merge(counters);
+        }); // parallelFor
 
-            // Now construct the board
-            Board<cNumRows, cNumCols> board(index);
+        ++pass;
+        stats.report(pass, passCounters);
 
-            // If the position is a WIN, then this is an illegal position.
-            if (board.isWin()) {
-                known.setBit(index, true);
-                tb.setBit(index, true); // All illegal board positions are given the game value WIN.
-                updated = true;
-                continue;
+        if (checkpointInterval > 0 && updated &&
+            std::chrono::steady_clock::now() - lastCheckpoint >= std::chrono::seconds(checkpointInterval)) {
+            checkpoint.save(pass, {&state.table()}, noValues);
+            lastCheckpoint = std::chrono::steady_clock::now();
+        }
+    } // while
+
+    // The database is written to its file in one go.
+    TableBase tb(filename, Index::size(), TableBase::Memory);
+    state.writeValues(tb);
+    tb.sync();
+    checkpoint.remove();
+} //  static void generateDatabase(const char *filename, int numThreads, int checkpointInterval, bool resume)
+
+// Sort a short list of index values, and remove the duplicates. Returns the
+// number of distinct values.
+static int sortUnique(uint64_t *values, int count)
+{
+    for (int i=1; i<count; ++i) {
+        for (int j=i; j>0 && values[j] < values[j-1]; --j) {
+            std::swap(values[j], values[j-1]);
+        }
+    }
+    return std::unique(values, values + count) - values;
+} // sortUnique
+
+// Call func(i) for each index value i whose bit is set in tb, in increasing
+// order. The table must be readable in whole 64-bit words, see
+// StateTable::forEachUnknown.
+template <typename Func>
+static void forEachSetBit(const TableBase& tb, Func func)
+{
+    const uint64_t *words = (const uint64_t *) tb.data();
+    for (ssize_t w = 0; w < tb.size() / 8; ++w) {
+        for (uint64_t word = words[w]; word; word &= word - 1) {
+            func(w * 64 + __builtin_ctzll(word));
+        }
+    }
+} // forEachSetBit
+
+// This is the retrograde version of generateDatabase. Rather than sweeping
+// over all positions until nothing changes, it works backwards from the
+// positions whose value is known. Each position keeps a count of its
+// successors that are not yet known to be lost for the opponent. Whenever a
+// position becomes known, its predecessors are visited exactly once:
+// If the position is a LOSS, then all predecessors are a WIN.
+// If the position is a WIN, then the count of each predecessor is decremented,
+// and when the count reaches zero, the predecessor is a LOSS.
+// This touches each position a bounded number of times, regardless of the
+// length of the game.
+//
+// The positions are resolved one level at a time, where level n holds the
+// positions that are decided n plies before the end of the game. So all
+// positions of a level are a LOSS (n even) or all a WIN (n odd). A level is
+// kept as a bitmap of one bit per index value, and the next level is
+// collected in a second bitmap, so the work list takes 2 bits per index
+// value, however many positions are resolved. The count is held in 4 bits.
+// A position with more than cMaxCount successors is given the count
+// cMaxCount, and is only found to be a LOSS by checking all its successors,
+// whenever one of them becomes a WIN.
+//
+// If withDistance is set, the distance table (see distance.h) is filled in at
+// the same time: A WIN is first reached from its fastest losing successor,
+// and a LOSS is decided by its slowest winning successor.
+template <typename Index>
+static void generateDatabaseRetrograde(const char *filename, bool withDistance)
+{
+    typedef typename Index::BoardType BoardType;
+
+    TableBase tb(filename, Index::size(), TableBase::Memory);
+
+    std::unique_ptr<DistanceTable> dt;
+    if (withDistance) {
+        dt.reset(new DistanceTable(DistanceTable::fileName(filename), Index::size(), TableBase::Memory));
+    }
+
+    // Number of successors, that are not yet known to be a WIN for the
+    // opponent, in 4 bits per index value. Zero for positions whose value is
+    // known.
+    const int cMaxCount = 15;
+    TableBase counts("", 4 * Index::size(), TableBase::Memory);
+    uint8_t *countBytes = counts.data();
+    auto readCount = [&](uint64_t index) {
+        return (countBytes[index/2] >> (4*(index%2))) & 0xF;
+    };
+    auto writeCount = [&](uint64_t index, int count) {
+        countBytes[index/2] = (countBytes[index/2] & ~(0xF << (4*(index%2)))) | (count << (4*(index%2)));
+    };
+
+    // The positions of the current and the next level, rounded up to whole
+    // 64-bit words for forEachSetBit.
+    ssize_t numFrontierBits = (Index::size() + 63) / 64 * 64;
+    TableBase frontierBits[2] = {{"", numFrontierBits, TableBase::Memory}, {"", numFrontierBits, TableBase::Memory}};
+    TableBase *frontier     = &frontierBits[0];
+    TableBase *nextFrontier = &frontierBits[1];
+
+    // All invalid indices are given the game value WIN.
+    Index::fillInvalid(tb);
+
+    // Return the distinct index values of the successors of a board. With the
+    // mirror index, two moves may lead to the same index value, which must
+    // only be counted once.
+    auto writeSuccessors = [](BoardType board, uint64_t *successors) {
+        typename BoardType::Position legalMoves[BoardType::cMaxMoves];
+        int moveCount = board.writeLegalMoves(legalMoves);
+        for (int i=0; i<moveCount; ++i) {
+            board.setPosition(legalMoves[i]);
+            successors[i] = Index::index(board);
+        }
+        return Index::cMirrored ? sortUnique(successors, moveCount) : moveCount;
+    };
+
+    // Return true if all successors of a position with a saturated count are
+    // a WIN. While a level of WINs is processed, the next level is a LOSS, so
+    // only the WINs of this and the earlier levels are set.
+    auto allSuccessorsWin = [&](uint64_t index) {
+        uint64_t successors[BoardType::cMaxMoves];
+        int moveCount = writeSuccessors(Index::board(index), successors);
+        for (int i=0; i<moveCount; ++i) {
+            if (!tb.readBit(successors[i])) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    // Find all terminal positions, and count the successors of the rest.
+    uint64_t numResolved = 0;
+    Index::forEachValid(0, Index::size(), [&](uint64_t index) {
+
+        // Now construct the board
+        BoardType board = Index::board(index);
+
+        // If the position is a WIN, then this is an illegal position.
+        if (board.isWin()) {
+            tb.setBit(index, true); // All illegal board positions are given the game value WIN.
+            return;
+        }
+
+        // If no successor available, then this position is a LOSS.
+        uint64_t successors[BoardType::cMaxMoves];
+        int moveCount = board.isLoss() ? 0 : writeSuccessors(board, successors);
+        if (!moveCount) {
+            frontier->setBit(index, true);
+            ++numResolved;
+            if (dt) {
+                dt->write(index, DistanceTable::encode(0));
+            }
+            return;
+        }
+
+        writeCount(index, std::min(moveCount, cMaxCount));
+    }); // forEachValid
+
+    std::cout << "Terminal positions : " << numResolved << std::endl;
+
+    // Propagate the known values backwards, one level at a time.
+    int level = 0;
+    for (uint64_t levelSize = numResolved; levelSize; ++level) {
+        bool isWin = level % 2;
+        levelSize = 0;
+
+        forEachSetBit(*frontier, [&](uint64_t index) {
+            BoardType board = Index::board(index);
+
+            typename BoardType::Position unMoves[BoardType::cMaxMoves];
+            int unMoveCount = board.writeUnmoves(unMoves);
+
+            uint64_t prevIndices[BoardType::cMaxMoves];
+            for (int i=0; i<unMoveCount; ++i) {
+                board.setPosition(unMoves[i]);
+                prevIndices[i] = Index::index(board);
+            }
+
+            // Each predecessor must only be visited once, see above.
+            if (Index::cMirrored) {
+                unMoveCount = sortUnique(prevIndices, unMoveCount);
             }
 
+            for (int i=0; i<unMoveCount; ++i) {
+                uint64_t prevIndex = prevIndices[i];
+                int count = readCount(prevIndex);
+
+                // Skip predecessors that are already known
+                if (!count) {
+                    continue;
+                }
+
+                if (isWin) {
+                    if (count < cMaxCount) {
+                        writeCount(prevIndex, --count);
+                    } else if (allSuccessorsWin(prevIndex)) {
+                        writeCount(prevIndex, count = 0);
+                    }
+                    if (count) {
+                        continue;
+                    }
+                    // All successors are winning, so the predecessor is lost.
+                } else {
+                    // This position is lost, so the predecessor is winning.
+                    writeCount(prevIndex, 0);
+                    tb.setBit(prevIndex, true);
+                }
+
+                nextFrontier->setBit(prevIndex, true);
+                ++levelSize;
+                if (dt) {
+                    dt->write(prevIndex, DistanceTable::encode(level + 1));
+                }
+            } // for
+        }); // forEachSetBit
+
+        numResolved += levelSize;
+        std::swap(frontier, nextFrontier);
+        nextFrontier->clear();
+    } // for
+
+    std::cout << "Resolved positions : " << numResolved << std::endl;
+    if (dt) {
+        std::cout << "Longest game       : " << level - 1 << " plies" << std::endl;
+    }
+
+    tb.sync();
+    if (dt) {
+        dt->sync();
+    }
+} // static void generateDatabaseRetrograde(const char *filename, bool withDistance)
+
+// Solve a single material slice, see slice.h, and store it in its own file.
+// The slices with one pawn less must already be solved and available in
+// finished, indexed by slice id. Returns the checksum of the slice, once it
+// is written to disk.
+template <typename Index, typename Slice>
+static uint64_t solveSlice(const char *filename, const Slice& slice,
+        const std::vector<std::unique_ptr<TableBase>>& finished, int numThreads)
+{
+    const uint64_t cChunkSize = 0x10000;
+    const uint8_t  cKnown     = 0xFF;   // Advancement value used for terminal positions.
+
+    std::cout << "Slice " << slice.getNumMost() << "-" << slice.getNumLeast()
+        << " : " << slice.size() << " positions" << std::endl;
+
+    TableBase tb(slice.fileName(filename), slice.size(), TableBase::Memory);
+
+    // Find all terminal positions, and the advancement of the rest.
+    std::vector<uint8_t> advancement(slice.size());
+    parallelFor(numThreads, slice.size(), cChunkSize, [&](int, uint64_t begin, uint64_t end) {
+        for (uint64_t index = begin; index < end; ++index) {
+            typename Index::BoardType board = slice.board(index);
+
             // If the position is a LOSS, then we're done with this position.
             if (board.isLoss()) {
-                known.setBit(index, true);
-                tb.setBit(index, false); // This position is a LOSS.
-                updated = true;
+                advancement[index] = cKnown;
                 continue;
             }
 
-            // Now we loop over all legal moves
-            // IF any successor leads to an unknown position, then this position is unknown too.
+            advancement[index] = board.getAdvancement();
+        }
+    });
+
+    // All successors within the slice have a larger advancement, so they are
+    // known before the position itself is visited.
+    for (int level = Slice::cMaxAdvancement; level >= 0; --level) {
+        parallelFor(numThreads, slice.size(), cChunkSize, [&](int, uint64_t begin, uint64_t end) {
+            MoveBatch<typename Index::BoardType> batch;
+
             // If any successor leads to a LOSS (for the opponent), then this position is a WIN.
             // If all successors lead to a WIN (for the opponent), then this position is a LOSS.
             // If no successor available, then this position is a LOSS.
-            bool isKnown = true;    // Assume position is known.
-            bool isWin   = false;   // Assume position is a LOSS, e.g. if no successors.
+            auto evaluateBatch = [&]() {
+                batch.generate();
 
-            uint32_t legalMoves[12];
-            int moveCount = board.writeLegalMoves(legalMoves);
+                for (int b=0; b<batch.count(); ++b) {
+                    bool isWin = false;
 
-            // Loop over all squares
-            for (int i=0; i<moveCount; ++i) {
-                board.setPosition(legalMoves[i]);
-                uint32_t newIndex = board.getIndex();
+                    typename Index::BoardType board;
+                    typename Index::BoardType::Position legalMoves[Index::BoardType::cMaxMoves];
+                    int moveCount = batch.writeLegalMoves(b, board, legalMoves);
+
+                    for (int i=0; i<moveCount; ++i) {
+                        board.setPosition(legalMoves[i]);
+                        Slice newSlice = Slice::fromBoard(board);
+
+                        bool newIsWin;
+                        if (newSlice == slice) {
+                            newIsWin = tb.readBitAtomic(slice.index(board));
+                        } else {
+                            assert (finished[newSlice.id()]);
+                            newIsWin = finished[newSlice.id()]->readBit(newSlice.index(board));
+                        }
+
+                        if (!newIsWin) {
+                            // If one child is lost, then we are winning, and can stop immediately.
+                            isWin = true;
+                            break;
+                        }
+                    } // end for
 
-                if (!known.readBit(newIndex))
-                {
-                    // If one child is unknown, then we can stop immediately.
-                    isKnown = false;
-                    break;
+                    tb.setBitAtomic(batch.index(b), isWin);
+                } // for
+
+                batch.clear();
+            }; // evaluateBatch
+
+            for (uint64_t index = begin; index < end; ++index) {
+                if (advancement[index] != level) {
+                    continue;
                 }
-                if (!tb.readBit(newIndex))
-                {
-                    // If one child is lost, then we are winning, and can stop immediately.
-                    isWin = true;
-                    break;
+
+                if (batch.add(index, slice.board(index).getPosition())) {
+                    evaluateBatch();
                 }
-            } // end for
+            }
 
-            if (isKnown) {
-                known.setBit(index, true);
-                tb.setBit(index, isWin);
-                updated = true;
+            evaluateBatch();
+        });
+    } // for
+
+    tb.sync();
+    return Checkpoint::checksum(tb.data(), tb.size());
+} // solveSlice
+
+// This generates the database one material slice at a time, see slice.h, in
+// order of increasing number of pawns. Each slice is stored in its own file,
+// named after the database, e.g. "touchdown.tb.4-3". Only the slice being
+// solved is written to, and the slices with one pawn less are opened
+// read-only, so the memory needed is bounded by the largest slice.
+// Finally, the database itself is assembled from the slices.
+//
+// If checkpointInterval is non-zero, a checkpoint (see checkpoint.h) with the
+// checksums of the solved slices is written after a slice, when at least that
+// many seconds have passed since the previous one. If resume is set, the
+// slices of the last checkpoint are not solved again, as long as their files
+// still have the same checksums.
+template <typename Index>
+static void generateDatabaseSliced(const char *filename, int numThreads, int checkpointInterval, bool resume)
+{
+    typedef MaterialSlice<Index::BoardType::cNumRows, Index::BoardType::cNumCols> Slice;
+    const int cNumPawns = Index::BoardType::cNumPawns;
+    const uint64_t cChunkSize = 0x10000;
+
+    std::vector<std::unique_ptr<TableBase>> finished(Slice::cNumIds);
+
+    // The checksums of the slices solved so far, in the order they are solved.
+    Checkpoint checkpoint(filename, Index::name() + "/slices", Index::size());
+    std::vector<uint64_t> checksums;
+    std::vector<uint64_t> savedChecksums;
+    uint64_t numSaved = 0;
+    if (resume && checkpoint.restore(numSaved, {}, savedChecksums)) {
+        std::cout << "Resuming after " << numSaved << " slices" << std::endl;
+    }
+    std::chrono::steady_clock::time_point lastCheckpoint = std::chrono::steady_clock::now();
+
+    for (int numPawns = 1; numPawns <= 2*cNumPawns; ++numPawns) {
+        // Close the slices that are no longer needed.
+        for (auto& table : finished) {
+            table.reset();
+        }
+
+        // Open the slices with one pawn less.
+        for (int numLeast = 0; 2*numLeast <= numPawns-1; ++numLeast) {
+            int numMost = numPawns-1 - numLeast;
+            if (numMost > 0 && numMost <= cNumPawns) {
+                Slice slice(numMost, numLeast);
+                finished[slice.id()].reset(new TableBase(slice.fileName(filename), slice.size(), TableBase::ReadOnly));
+            }
+        }
+
+        // All slices with the same number of pawns are independent of each other.
+        for (int numLeast = 0; 2*numLeast <= numPawns; ++numLeast) {
+            int numMost = numPawns - numLeast;
+            if (numMost > cNumPawns) {
+                continue;
+            }
+            Slice slice(numMost, numLeast);
+
+            // Skip the slices of the checkpoint, that are unchanged.
+            if (checksums.size() < savedChecksums.size()) {
+                TableBase solved(slice.fileName(filename), slice.size(), TableBase::ReadOnly);
+                uint64_t checksum = Checkpoint::checksum(solved.data(), solved.size());
+                if (checksum == savedChecksums[checksums.size()]) {
+                    std::cout << "Slice " << numMost << "-" << numLeast << " : already solved" << std::endl;
+                    checksums.push_back(checksum);
+                    continue;
+                }
+                savedChecksums.clear();     // Solve this and all following slices again.
+            }
+
+            checksums.push_back(solveSlice<Index>(filename, slice, finished, numThreads));
+
+            if (checkpointInterval > 0 &&
+                std::chrono::steady_clock::now() - lastCheckpoint >= std::chrono::seconds(checkpointInterval)) {
+                checkpoint.save(checksums.size(), {}, checksums);
+                lastCheckpoint = std::chrono::steady_clock::now();
+            }
+        }
+    } // for
+
+    // Open all slices.
+    for (int numMost = 1; numMost <= cNumPawns; ++numMost) {
+        for (int numLeast = 0; numLeast <= numMost; ++numLeast) {
+            Slice slice(numMost, numLeast);
+            finished[slice.id()].reset(new TableBase(slice.fileName(filename), slice.size(), TableBase::ReadOnly));
+        }
+    }
+
+    std::cout << "Assembling database" << std::endl;
+
+    TableBase tb(filename, Index::size(), TableBase::Memory);
+
+    // All invalid indices are given the game value WIN.
+    Index::fillInvalid(tb);
+
+    parallelFor(numThreads, Index::size(), cChunkSize, [&](int, uint64_t begin, uint64_t end) {
+        Index::forEachValid(begin, end, [&](uint64_t index) {
+            // Now construct the board
+            typename Index::BoardType board = Index::board(index);
+
+            // If the position is a WIN, then this is an illegal position.
+            if (board.isWin()) {
+                tb.setBitAtomic(index, true); // All illegal board positions are given the game value WIN.
+                return;
+            }
+
+            Slice slice = Slice::fromBoard(board);
+            tb.setBitAtomic(index, finished[slice.id()]->readBit(slice.index(board)));
+        });
+    });
+
+    tb.sync();
+    checkpoint.remove();
+} // static void generateDatabaseSliced(const char *filename, int numThreads, int checkpointInterval, bool resume)
+
+// Read size bytes at offset of the file fd.
+static void readFully(int fd, uint8_t *data, uint64_t size, uint64_t offset)
+{
+    while (size > 0) {
+        ssize_t count = pread(fd, data, size, offset);
+        if (count <= 0)
+        {
+            perror("pread");
+            assert (false);
+        }
+        data   += count;
+        size   -= count;
+        offset += count;
+    }
+} // readFully
+
+// Write size bytes at offset of the file fd.
+static void writeFully(int fd, const uint8_t *data, uint64_t size, uint64_t offset)
+{
+    while (size > 0) {
+        ssize_t count = pwrite(fd, data, size, offset);
+        if (count <= 0)
+        {
+            perror("pwrite");
+            assert (false);
+        }
+        data   += count;
+        size   -= count;
+        offset += count;
+    }
+} // writeFully
+
+// This generates the database like generateDatabase, for databases that do
+// not fit in memory. The states of the positions (see statetable.h) are kept
+// in a file, e.g. "touchdown.tb.state", which is only accessed by reading and
+// writing large blocks, using at most memoryBudget bytes of memory:
+// * A quarter holds a segment of the states, which is read, updated, and
+//   written back. The positions of the segment that are still unknown are
+//   visited in order.
+// * Half holds the requests for the states of their successors. When it is
+//   full, the requests are sorted by index value, and resolved by reading the
+//   state file sequentially, skipping the parts that are not needed.
+// * A quarter is the buffer of those reads.
+// Then the results are combined into the values of the visited positions.
+// A successor in the same segment is read from the segment itself.
+//
+// A state only ever changes from Unknown to known, so the state file is
+// always consistent, and if resume is set, the generation continues from the
+// state file, if there is one.
+template <typename Index>
+static void generateDatabaseOutOfCore(const char *filename, uint64_t memoryBudget, bool resume,
+        const char *statsFileName)
+{
+    typedef typename Index::BoardType BoardType;
+    const uint64_t cPageSize    = 4096;
+    const uint8_t  cAnyUnknown  = 1;    // Flags of the visited positions.
+    const uint8_t  cAnyLoss     = 2;
+
+    struct Request {
+        uint64_t index;     // Index value of the successor.
+        uint32_t parent;    // Number of the visited position.
+    }; // Request
+
+    uint64_t segmentBytes = std::max(cPageSize, memoryBudget / 4 / cPageSize * cPageSize);
+    uint64_t segmentSize  = 4 * segmentBytes;   // Positions per segment.
+    uint64_t readBytes    = segmentBytes;
+    uint64_t maxRequests  = std::max<uint64_t>(4 * BoardType::cMaxMoves,
+                                               memoryBudget / 2 / (sizeof(Request) + sizeof(uint64_t) + 1));
+    uint64_t numBytes     = (Index::size() + 31) / 32 * 8;     // Size of the state file.
+
+    std::string stateName = std::string(filename) + ".state";
+    int fd = open(stateName.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+    if (fd < 0)
+    {
+        perror("open");
+        assert (false);
+    }
+
+    std::vector<uint8_t> segment(segmentBytes);
+    std::vector<uint8_t> buffer(readBytes);
+
+    struct stat st;
+    if (resume && !fstat(fd, &st) && (uint64_t) st.st_size == numBytes) {
+        std::cout << "Resuming from " << stateName << std::endl;
+    } else {
+        if (ftruncate(fd, 0) || posix_fallocate(fd, 0, numBytes))
+        {
+            perror("fallocate");
+            assert (false);
+        }
+
+        // Initially all valid positions are unknown, and the rest invalid.
+        for (uint64_t begin = 0; begin < Index::size(); begin += segmentSize) {
+            uint64_t end   = std::min<uint64_t>(begin + segmentSize, Index::size());
+            uint64_t bytes = std::min(segmentBytes, numBytes - begin / 4);
+            memset(segment.data(), 0xFF, bytes);
+            Index::forEachValid(begin, end, [&](uint64_t index) {
+                segment[(index - begin) / 4] &= ~(3 << (2 * (index % 4)));
+            });
+            // The padding after the last position is never visited, and
+            // left as LOSS, as by the other generators.
+            for (uint64_t index = end; index < begin + 4 * bytes; ++index) {
+                segment[(index - begin) / 4] &= ~(3 << (2 * (index % 4)));
             }
+            writeFully(fd, segment.data(), bytes, begin / 4);
+        }
+    }
+
+    std::vector<Request>  requests;
+    std::vector<uint64_t> parents;
+    std::vector<uint8_t>  flags;
+    requests.reserve(maxRequests);
+
+    PassStats stats(statsFileName, {});
+
+    bool updated = true;
+    for (int pass = 1; updated; ++pass) {
+        updated = false;
+        PassCounters counters;
+        uint64_t bytesRead = 0;
+
+        for (uint64_t begin = 0; begin < Index::size(); begin += segmentSize) {
+            uint64_t end   = std::min<uint64_t>(begin + segmentSize, Index::size());
+            uint64_t bytes = std::min(segmentBytes, numBytes - begin / 4);
+            readFully(fd, segment.data(), bytes, begin / 4);
+            bytesRead += bytes;
+
+            // Resolve the requests, and update the visited positions.
+            auto resolve = [&]() {
+                std::sort(requests.begin(), requests.end(), [](const Request& a, const Request& b) {
+                    return a.index < b.index;
+                });
+
+                uint64_t windowBegin = 0;
+                uint64_t windowEnd   = 0;
+                for (const Request& request : requests) {
+                    StateTable::State state;
+                    if (request.index >= begin && request.index < end) {
+                        state = StateTable::read(segment.data(), request.index - begin);
+                    } else {
+                        uint64_t byte = request.index / 4;
+                        if (byte >= windowEnd) {
+                            windowBegin = byte / cPageSize * cPageSize;
+                            windowEnd   = std::min(windowBegin + readBytes, numBytes);
+                            readFully(fd, buffer.data(), windowEnd - windowBegin, windowBegin);
+                            bytesRead += windowEnd - windowBegin;
+                        }
+                        state = StateTable::read(buffer.data(), request.index - 4 * windowBegin);
+                    }
+                    if (state == StateTable::Unknown) {
+                        flags[request.parent] |= cAnyUnknown;
+                    } else if (state == StateTable::Loss) {
+                        flags[request.parent] |= cAnyLoss;
+                    }
+                }
+
+                // If any successor is a LOSS (for the opponent), then this position is a WIN.
+                // If all successors are a WIN (for the opponent), then this position is a LOSS.
+                for (size_t p = 0; p < parents.size(); ++p) {
+                    if (flags[p] & cAnyLoss) {
+                        StateTable::set(segment.data(), parents[p] - begin, StateTable::Win);
+                        counters.resolvedWin.add();
+                    } else if (!(flags[p] & cAnyUnknown)) {
+                        StateTable::set(segment.data(), parents[p] - begin, StateTable::Loss);
+                        counters.resolvedLoss.add();
+                    } else {
+                        continue;
+                    }
+                    updated = true;
+                }
+
+                requests.clear();
+                parents.clear();
+                flags.clear();
+            }; // resolve
+
+            StateTable::forEachUnknown(segment.data(), 0, end - begin, [&](uint64_t offset) {
+                uint64_t index = begin + offset;
+                counters.visited.add();
+
+                BoardType board = Index::board(index);
+
+                // All illegal board positions are given the game value WIN.
+                if (board.isWin()) {
+                    StateTable::set(segment.data(), offset, StateTable::Win);
+                    updated = true;
+                    return;
+                }
+
+                typename BoardType::Position legalMoves[BoardType::cMaxMoves];
+                int moveCount = board.isLoss() ? 0 : board.writeLegalMoves(legalMoves);
+                if (!moveCount) {
+                    StateTable::set(segment.data(), offset, StateTable::Loss);
+                    counters.resolvedLoss.add();
+                    updated = true;
+                    return;
+                }
+
+                for (int i=0; i<moveCount; ++i) {
+                    board.setPosition(legalMoves[i]);
+                    requests.push_back({Index::index(board), (uint32_t) parents.size()});
+                }
+                counters.probed.add(moveCount);
+                parents.push_back(index);
+                flags.push_back(0);
+
+                if (requests.size() + BoardType::cMaxMoves > maxRequests) {
+                    resolve();
+                }
+            }); // forEachUnknown
+
+            resolve();
+            writeFully(fd, segment.data(), bytes, begin / 4);
         } // for
-    } // while
 
-    std::cout << std::endl;
-} //  static void generateDatabase(const char *filename)
+        stats.report(pass, counters);
+        std::cout << "         " << (bytesRead >> 20) << " MB read" << std::endl;
+    } // for
 
-static void showLine(const char *filename)
+    // Write the database, one segment at a time.
+    int dbFd = open(filename, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (dbFd < 0)
+    {
+        perror("open");
+        assert (false);
+    }
+    uint64_t dbBytes = (Index::size() + 7) / 8;
+    for (uint64_t begin = 0; begin < Index::size(); begin += segmentSize) {
+        uint64_t bytes = std::min(segmentBytes, numBytes - begin / 4);
+        uint64_t valueBytes = std::min(segmentBytes / 2, dbBytes - begin / 8);
+        readFully(fd, segment.data(), bytes, begin / 4);
+        StateTable::writeValues(segment.data(), buffer.data(), valueBytes);
+        writeFully(dbFd, buffer.data(), valueBytes, begin / 8);
+    }
+    if (fsync(dbFd) || close(dbFd))
+    {
+        perror("fsync");
+        assert (false);
+    }
+
+    close(fd);
+    unlink(stateName.c_str());
+} // generateDatabaseOutOfCore
+
+// If withDistance is set, the distance table (see distance.h) is used to
+// select the fastest win, or the longest resistance when losing.
+template <typename Index, typename Table>
+static void showLine(const char *filename, bool withDistance)
 {
-    TableBase tb(filename);
+    Table tb(filename, Index::size(), TableBase::ReadOnly);
+
+    std::unique_ptr<DistanceTable> dt;
+    if (withDistance) {
+        dt.reset(new DistanceTable(DistanceTable::fileName(filename), Index::size(), TableBase::ReadOnly));
+    }
 
-    Board<cNumRows, cNumCols> board(0xF0F00F);  // Select the initial position for now.
+    typename Index::BoardType board;   // Select the initial position for now.
     std::cout << "Starting position : " << std::endl;
 
     bool xToMove = true;
@@ -267,7 +1238,12 @@ static void showLine(const char *filename)
         if (!xToMove) {
             board.setPosition(board.swapPosition(board.getPosition()));
         }
-        std::cout << (xToMove ? "X" : "O") << " to move." << std::endl << std::endl;;
+        std::cout << (xToMove ? "X" : "O") << " to move.";
+        if (dt) {
+            uint8_t value = dt->read(Index::index(board));
+            std::cout << (DistanceTable::isWin(value) ? " Wins" : " Loses") << " in " << DistanceTable::plies(value) << " plies.";
+        }
+        std::cout << std::endl << std::endl;
 
         xToMove = !xToMove;
 
@@ -275,37 +1251,296 @@ static void showLine(const char *filename)
         if (board.isLoss())
             break;
 
-        uint32_t legalMoves[12];
+        typename Index::BoardType::Position legalMoves[Index::BoardType::cMaxMoves];
         int moveCount = board.writeLegalMoves(legalMoves);
 
         // Check for end of game.
         if (!moveCount)
             break;
 
+        if (dt) {
+            // Select the move to the position decided in the fewest plies,
+            // if it is a LOSS for the opponent, and otherwise in the most
+            // plies. I.e. the best move has the lowest key.
+            int bestMove = 0;
+            int bestKey  = 0;
+            for (int i=0; i<moveCount; ++i) {
+                board.setPosition(legalMoves[i]);
+                uint8_t value = dt->read(Index::index(board));
+                int key = DistanceTable::isWin(value) ? -DistanceTable::plies(value) : DistanceTable::plies(value) - 3 * DistanceTable::cMaxPlies;
+                if (i == 0 || key < bestKey) {
+                    bestMove = i;
+                    bestKey  = key;
+                }
+            }
+            board.setPosition(legalMoves[bestMove]);
+            continue;
+        }
+
         // Loop over all legal moves
         // If there is a winner move, select it.
         // If not, just use the last move in the last.
         for (int i=0; i<moveCount; ++i) {
             board.setPosition(legalMoves[i]);   // Select current move.
-            if (!tb.readBit(board.getIndex()))
+            if (!tb.readBit(Index::index(board)))
                 break;                          // Found a winner move.
         }
     }
 } // showLine
 
 
-// This program creates a database over ALL legal positions on the 4x4 touchdown
+// Answer queries about the database, see server.h. The queries are read
+// from standard input, or from connections to a Unix domain socket.
+template <typename Index, typename Table>
+static void serveDatabase(const char *filename, const char *socketPath, bool withDistance)
+{
+    QueryServer<Index, Table> server(filename, withDistance);
+
+    if (socketPath) {
+        server.listen(socketPath);
+    } else {
+        server.serve(STDIN_FILENO, STDOUT_FILENO);
+    }
+} // serveDatabase
+
+// Search the positions read from standard input, one per line, as written by
+// Board::toShortString, see search.h. The slices of the database filename
+// that exist are used, if filename is given. Each position is answered by one
+// line, with the value, the depth searched, the number of positions searched,
+// and the position after the best move, e.g.
+//    WIN 11 depth 11 nodes 2386 nps 1590666 best ...O ..O. .X.. ..X.
+// The value is "WIN n" or "LOSS n" if the game ends in n plies, just "WIN" or
+// "LOSS" if it is decided by a slice, or "SCORE s" with the estimate s
+// otherwise. Malformed and illegal positions are answered by "ERROR" and
+// "ILLEGAL".
+template <typename Index>
+static void searchPositions(const char *filename, int numThreads, int maxDepth, int milliseconds, int hashSize)
+{
+    typedef typename Index::BoardType BoardType;
+    typedef Search<BoardType> SearchType;
+
+    SliceTables<BoardType::cNumRows, BoardType::cNumCols> slices(filename ? filename : "");
+    TranspositionTable tt(hashSize);
+    SearchType search(slices, tt, numThreads);
+
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        BoardType board;
+        if (!board.fromShortString(line)) {
+            std::cout << "ERROR" << std::endl;
+            continue;
+        }
+        if (board.isWin()) {
+            std::cout << "ILLEGAL" << std::endl;
+            continue;
+        }
+
+        SearchResult<BoardType> result = search.run(board, maxDepth, milliseconds);
+        int score = result.score;
+        if (!SearchType::isDecided(score)) {
+            std::cout << "SCORE " << score;
+        } else if (score > SearchType::cTableBaseWin || score < -SearchType::cTableBaseWin) {
+            std::cout << (score > 0 ? "WIN " : "LOSS ") << SearchType::cWin - std::abs(score);
+        } else {
+            std::cout << (score > 0 ? "WIN" : "LOSS");
+        }
+        std::cout << " depth " << result.depth << " nodes " << result.nodes
+                  << " nps " << (uint64_t) (result.seconds > 0 ? result.nodes / result.seconds : 0);
+        if (result.moveCount) {
+            board.setPosition(BoardType::swapPosition(result.bestMove));
+            std::cout << " best " << board.toShortString();
+        }
+        std::cout << std::endl;
+    }
+} // searchPositions
+
+// Count the leaf nodes depth plies below a position (perft), see perft.h,
+// from the initial position, or the one given as by Board::toShortString.
+// Prints the count below each move, as the position after the move, and the
+// total, e.g.
+//    perft 8 : 29216 nodes, 0.000 s, 71794063 nodes/s, 240 cache hits
+template <typename Index>
+static void perftPosition(const char *position, int depth, int numThreads, int hashSize)
+{
+    typedef typename Index::BoardType BoardType;
+
+    BoardType board;
+    if (position && !board.fromShortString(position)) {
+        std::cout << "Malformed position: " << position << std::endl;
+        return;
+    }
+    if (board.isWin()) {
+        std::cout << "Illegal position: " << board.toShortString() << std::endl;
+        return;
+    }
+
+    Perft<BoardType> perft(numThreads, hashSize);
+    PerftResult<BoardType> result = perft.run(board, depth);
+    for (size_t i = 0; i < result.moves.size(); ++i) {
+        BoardType child;
+        child.setPosition(BoardType::swapPosition(result.moves[i]));
+        std::cout << child.toShortString() << " : " << result.counts[i] << std::endl;
+    }
+    std::cout << "perft " << depth << " : " << result.nodes << " nodes, "
+              << std::fixed << std::setprecision(3) << result.seconds << " s, "
+              << (uint64_t) (result.seconds > 0 ? result.nodes / result.seconds : 0) << " nodes/s, "
+              << result.cacheHits << " cache hits" << std::endl;
+} // perftPosition
+
+// Write a compressed copy of the database, see compressed.h, named e.g.
+// "touchdown.tb.z". All modes that read a database also accept the
+// compressed file. Returns false if it could not be written.
+template <typename Index>
+static bool compressDatabase(const char *filename)
+{
+    TableBase tb(filename, Index::size(), TableBase::ReadOnly);
+
+    std::string compressedName = std::string(filename) + ".z";
+    if (!CompressedTableBase::compress(tb, compressedName, Index::size(),
+                                       Index::BoardType::cNumRows, Index::BoardType::cNumCols, Index::name())) {
+        fprintf(stderr, "%s : Could not write the compressed database\n", compressedName.c_str());
+        return false;
+    }
+
+    struct stat st;
+    stat(compressedName.c_str(), &st);
+    std::cout << compressedName << " : " << st.st_size << " bytes, "
+              << std::fixed << std::setprecision(1) << 100.0 * st.st_size / tb.size() << "% of " << tb.size() << " bytes" << std::endl;
+    return true;
+} // compressDatabase
+
+// The command line options.
+struct Options
+{
+    char        mode       = 'g';       // Default is to generate the database.
+    const char *filename   = nullptr;
+    bool        retrograde = false;
+    bool        sliced     = false;
+    bool        distance   = false;     // Generate or use the distance table.
+    const char *socketPath = nullptr;
+    uint64_t    seed       = 0;         // Shuffle the exported positions, if non-zero.
+    int         validationPercent = 0;
+    int         checkpointInterval = 0; // Seconds between checkpoints, or zero for none.
+    bool        resume     = false;     // Resume from the last checkpoint.
+    const char *statsFileName = nullptr; // JSON log of the generation statistics.
+    int         searchDepth = 0;        // Maximum depth of the search, or zero for none.
+    int         searchTime = 1000;      // Milliseconds per searched position, or zero for no limit.
+    int         hashSize   = 64;        // Megabytes of the transposition table.
+    uint64_t    memoryBudget = 0;       // Megabytes used to generate out of core, or zero for in memory.
+    int         perftDepth = 0;
+    const char *position   = nullptr;   // Position of perft, or nullptr for the initial position.
+    int         numThreads = 1;
+}; // Options
+
+// Run a mode that reads an existing database, which is either a plain
+// TableBase or a CompressedTable.
+template <typename Index, typename Table>
+static int runReadOnly(const Options& options)
+{
+    switch (options.mode)
+    {
+        case 'd' : dumpDatabase<Index, Table>(options.filename); return 0;
+        case 'o' : outputDatabase<Index, Table>(options.filename); return 0;
+        case 'e' : exportDatabase<Index, Table>(options.filename, options.seed, options.validationPercent, options.numThreads); return 0;
+        case 's' : summarizeDatabase<Index, Table>(options.filename); return 0;
+        case 'v' : return verifyDatabase<Index, Table>(options.filename, options.numThreads) ? 0 : 1;
+        case 'l' : showLine<Index, Table>(options.filename, options.distance); return 0;
+        case 'q' : serveDatabase<Index, Table>(options.filename, options.socketPath, options.distance); return 0;
+    }
+    return 1;
+} // runReadOnly
+
+// Run the selected mode, using the given index scheme.
+template <typename Index>
+static int run(const Options& options)
+{
+    switch (options.mode)
+    {
+        case 'i' : indexTest(); return 0;    // Only relevant for the 24-bit index.
+        case 'c' : dumpAllValidIndices<Index>(); return 0;
+        case 'b' : dumpAllLegalBoards<Index>(); return 0;
+        case 'k' : return compressDatabase<Index>(options.filename) ? 0 : 1;
+        case 'a' : searchPositions<Index>(options.filename, options.numThreads, options.searchDepth,
+                                          options.searchTime, options.hashSize); return 0;
+        case 'f' : perftPosition<Index>(options.position, options.perftDepth, options.numThreads, options.hashSize); return 0;
+        case 'd' :
+        case 'o' :
+        case 'e' :
+        case 's' :
+        case 'v' :
+        case 'l' :
+        case 'q' :
+            if (CompressedTableBase::isCompressed(options.filename)) {
+                return runReadOnly<Index, CompressedTable<Index>>(options);
+            }
+            return runReadOnly<Index, TableBase>(options);
+    }
+
+    if (options.retrograde || options.distance) {
+        generateDatabaseRetrograde<Index>(options.filename, options.distance);
+    } else if (options.memoryBudget) {
+        generateDatabaseOutOfCore<Index>(options.filename, options.memoryBudget << 20, options.resume,
+                                         options.statsFileName);
+    } else if (options.sliced) {
+        generateDatabaseSliced<Index>(options.filename, options.numThreads, options.checkpointInterval, options.resume);
+    } else {
+        generateDatabase<Index>(options.filename, options.numThreads, options.checkpointInterval, options.resume,
+                                options.statsFileName);
+    }
+    return 0;
+} // run
+
+
+// This program creates a database over ALL legal positions on the touchdown
 // board, and calculates the game theoretic value for each position.
+// The supported board sizes are 4x4 (the default), 6x4, and 8x6. Only the
+// 4x4 board supports the 24-bit index, the larger boards always use the rank
+// index.
+
+// Options that only have a long name.
+enum {
+    cOptionCheckpoint = 256,
+    cOptionResume,
+    cOptionStats,
+    cOptionDepth,
+    cOptionTime,
+    cOptionHash,
+    cOptionMemory,
+    cOptionPosition
+};
+
+// The long names of the options.
+static const struct option cLongOptions[] = {
+    {"help",       no_argument,       nullptr, 'h'},
+    {"retrograde", no_argument,       nullptr, 'r'},
+    {"slices",     no_argument,       nullptr, 'm'},
+    {"distance",   no_argument,       nullptr, 't'},
+    {"threads",    required_argument, nullptr, 'j'},
+    {"board",      required_argument, nullptr, 'n'},
+    {"checkpoint", required_argument, nullptr, cOptionCheckpoint},
+    {"resume",     no_argument,       nullptr, cOptionResume},
+    {"stats",      required_argument, nullptr, cOptionStats},
+    {"depth",      required_argument, nullptr, cOptionDepth},
+    {"time",       required_argument, nullptr, cOptionTime},
+    {"hash",       required_argument, nullptr, cOptionHash},
+    {"memory",     required_argument, nullptr, cOptionMemory},
+    {"perft",      required_argument, nullptr, 'f'},
+    {"position",   required_argument, nullptr, cOptionPosition},
+    {nullptr,      0,                 nullptr, 0}
+};
 
 int main(int argc, char **argv) {
-    assert(cNumRows==4 && cNumCols == 4);
+    // Detect the CPU features used for index calculations.
+    indexInit();
 
-    // Initialize table for calculating the bit-reverse of a number.
-    indexReverseInit();
+    Options     options;
+    bool        rankIndex   = false;
+    bool        mirrorIndex = false;
+    std::string boardSize   = "4x4";
 
     // Process command line options
-    char c;
-    while ((c = getopt(argc, argv, "hicbd:s:o:l:")) != -1) {
+    int c;
+    while ((c = getopt_long(argc, argv, "hicbarmtxyd:s:o:e:z:p:k:l:q:u:j:n:f:v:", cLongOptions, nullptr)) != -1) {
         switch (c)
         {
             case 'h' :
@@ -317,25 +1552,101 @@ int main(int argc, char **argv) {
                 std::cout << "-b : Dump all legal boards."                << std::endl;
                 std::cout << "-d : Dump existing database."               << std::endl;
                 std::cout << "-o : Output existing database."             << std::endl;
+                std::cout << "-e : Export existing database as training data (.npy files)." << std::endl;
+                std::cout << "-z : Shuffle the exported positions with this seed." << std::endl;
+                std::cout << "-p : Percentage of the exported positions used for validation." << std::endl;
                 std::cout << "-s : Summarize existing database."          << std::endl;
+                std::cout << "-v : Verify existing database against the successors of each position." << std::endl;
+                std::cout << "-k : Compress existing database."           << std::endl;
                 std::cout << "-l : Show best line."                       << std::endl;
+                std::cout << "-q : Answer queries about existing database." << std::endl;
+                std::cout << "-u : Read queries from this Unix socket, rather than stdin." << std::endl;
+                std::cout << "-a : Search the positions read from stdin, using the slices of the database, if given." << std::endl;
+                std::cout << "-f : Count the leaf nodes of the game tree to this depth (perft)." << std::endl;
+                std::cout << "-r : Generate database using retrograde analysis." << std::endl;
+                std::cout << "-m : Generate database one material slice at a time." << std::endl;
+                std::cout << "-t : Generate distance table (implies -r), or use it with -l and -q." << std::endl;
+                std::cout << "-j : Number of threads used to generate or verify database, or to search." << std::endl;
+                std::cout << "-x : Use the dense rank index instead of the 24-bit index." << std::endl;
+                std::cout << "-y : Use the rank index reduced by mirror symmetry." << std::endl;
+                std::cout << "-n : Board size: 4x4 (default), 6x4, or 8x6." << std::endl;
+                std::cout << "--checkpoint <seconds> : Write a checkpoint while generating, at most this often." << std::endl;
+                std::cout << "--resume : Resume generating from the last checkpoint." << std::endl;
+                std::cout << "--memory <megabytes> : Generate database out of core, using at most this much memory." << std::endl;
+                std::cout << "--stats <file> : Write statistics of each sweep as JSON lines to this file." << std::endl;
+                std::cout << "--depth <plies> : Maximum depth of the search (-a)." << std::endl;
+                std::cout << "--time <milliseconds> : Time limit of the search (-a) per position, default 1000." << std::endl;
+                std::cout << "--hash <megabytes> : Size of the transposition table of the search (-a), or of the" << std::endl;
+                std::cout << "    cache of perft (-f), default 64. Zero disables the cache of perft." << std::endl;
+                std::cout << "--position <board> : Position of perft (-f), as for -q, default the initial position." << std::endl;
+                std::cout << "The long names of -f, -r, -m, -t, -j, and -n are --perft, --retrograde, --slices," << std::endl;
+                std::cout << "--distance, --threads, and --board." << std::endl;
                 return 0;
-            case 'i' : indexTest(); return 0;
-            case 'c' : dumpAllValidIndices(); return 0;
-            case 'b' : dumpAllLegalBoards(); return 0;
-            case 'd' : dumpDatabase(optarg); return 0;
-            case 'o' : outputDatabase(optarg); return 0;
-            case 's' : summarizeDatabase(optarg); return 0;
-            case 'l' : showLine(optarg); return 0;
+            case 'i' :
+            case 'c' :
+            case 'b' :
+            case 'a' : options.mode = c; break;
+            case 'd' :
+            case 'o' :
+            case 'e' :
+            case 'k' :
+            case 's' :
+            case 'v' :
+            case 'l' :
+            case 'q' : options.mode = c; options.filename = optarg; break;
+            case 'u' : options.socketPath = optarg; break;
+            case 'z' : options.seed = strtoull(optarg, nullptr, 0); break;
+            case 'p' : options.validationPercent = atoi(optarg); break;
+            case 'r' : options.retrograde = true; break;
+            case 'm' : options.sliced = true; break;
+            case 't' : options.distance = true; break;
+            case 'j' : options.numThreads = atoi(optarg); break;
+            case 'x' : rankIndex = true; break;
+            case 'y' : mirrorIndex = true; break;
+            case 'n' : boardSize = optarg; break;
+            case 'f' : options.mode = c; options.perftDepth = atoi(optarg); break;
+            case cOptionCheckpoint : options.checkpointInterval = atoi(optarg); break;
+            case cOptionResume     : options.resume = true; break;
+            case cOptionStats      : options.statsFileName = optarg; break;
+            case cOptionDepth      : options.searchDepth = atoi(optarg); break;
+            case cOptionTime       : options.searchTime = atoi(optarg); break;
+            case cOptionHash       : options.hashSize = atoi(optarg); break;
+            case cOptionMemory     : options.memoryBudget = strtoull(optarg, nullptr, 0); break;
+            case cOptionPosition   : options.position = optarg; break;
             default  : abort ();
         }
     } // while
 
-    if (optind >= argc) {
-        std::cout << "Missing database filename" << std::endl;
-        return 1;
+    if (!options.filename) {
+        if (optind >= argc && options.mode == 'g') {
+            std::cout << "Missing database filename" << std::endl;
+            return 1;
+        }
+        options.filename = argv[optind];
     }
 
-    generateDatabase(argv[optind]);
-} // main
+    if (boardSize == "4x4") {
+        if (mirrorIndex) {
+            return run<MirrorIndex<4, 4>>(options);
+        }
+        if (rankIndex) {
+            return run<RankIndex<4, 4>>(options);
+        }
+        return run<SparseIndex<4, 4>>(options);
+    }
+    if (boardSize == "6x4") {
+        if (mirrorIndex) {
+            return run<MirrorIndex<4, 6>>(options);
+        }
+        return run<RankIndex<4, 6>>(options);
+    }
+    if (boardSize == "8x6") {
+        if (mirrorIndex) {
+            return run<MirrorIndex<6, 8>>(options);
+        }
+        return run<RankIndex<6, 8>>(options);
+    }
 
+    std::cout << "Unsupported board size " << boardSize << std::endl;
+    return 1;
+} // main
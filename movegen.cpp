@@ -0,0 +1,181 @@
+#include <immintrin.h>
+#include "movegen.h"
+
+// The vector units available, in order of preference.
+enum MovegenLevel
+{
+   MOVEGEN_SCALAR,
+   MOVEGEN_AVX2,
+   MOVEGEN_AVX512
+};
+
+static MovegenLevel movegenLevel()
+{
+   static const MovegenLevel level =
+      __builtin_cpu_supports("avx512f") ? MOVEGEN_AVX512 :
+      __builtin_cpu_supports("avx2")    ? MOVEGEN_AVX2   :
+      MOVEGEN_SCALAR;
+   return level;
+} // movegenLevel
+
+const char *movegenName()
+{
+   switch (movegenLevel())
+   {
+      case MOVEGEN_AVX512 : return "avx512";
+      case MOVEGEN_AVX2   : return "avx2";
+      default             : return "scalar";
+   }
+} // movegenName
+
+// The vector code below is the same as Board::getMoveSources, for 8 or 16
+// positions at a time.
+//
+// The plain AVX-512 shift and andnot intrinsics of GCC 12 start from an
+// undefined vector, which triggers -Wmaybe-uninitialized warnings. The
+// AVX-512 code uses the zero-masked versions with all lanes selected
+// instead, which start from a zeroed vector and give the same result.
+
+__attribute__((target("avx2")))
+static int sources32Avx2(const uint32_t *positions, int count, const MovegenParams& params,
+      uint32_t *push, uint32_t *right, uint32_t *left)
+{
+   const __m256i allSquares  = _mm256_set1_epi32(params.allSquares);
+   const __m256i notRightCol = _mm256_set1_epi32(params.notRightCol);
+   const __m256i notLeftCol  = _mm256_set1_epi32(params.notLeftCol);
+   const __m128i shiftPlayer = _mm_cvtsi32_si128(params.numSquares);
+   const __m128i shiftPush   = _mm_cvtsi32_si128(params.numCols);
+   const __m128i shiftRight  = _mm_cvtsi32_si128(params.numCols-1);
+   const __m128i shiftLeft   = _mm_cvtsi32_si128(params.numCols+1);
+
+   int i = 0;
+   for (; i+8 <= count; i += 8) {
+      __m256i position = _mm256_loadu_si256((const __m256i *) (positions+i));
+      __m256i occupied = _mm256_and_si256(position, allSquares);
+      __m256i player   = _mm256_srl_epi32(position, shiftPlayer);
+      __m256i opponent = _mm256_andnot_si256(player, occupied);
+
+      __m256i p = _mm256_andnot_si256(_mm256_sll_epi32(occupied, shiftPush), player);
+      __m256i r = _mm256_and_si256(_mm256_and_si256(player, notRightCol), _mm256_sll_epi32(opponent, shiftRight));
+      __m256i l = _mm256_and_si256(_mm256_and_si256(player, notLeftCol), _mm256_sll_epi32(opponent, shiftLeft));
+
+      _mm256_storeu_si256((__m256i *) (push+i), p);
+      _mm256_storeu_si256((__m256i *) (right+i), r);
+      _mm256_storeu_si256((__m256i *) (left+i), l);
+   }
+   return i;
+} // sources32Avx2
+
+__attribute__((target("avx512f")))
+static int sources32Avx512(const uint32_t *positions, int count, const MovegenParams& params,
+      uint32_t *push, uint32_t *right, uint32_t *left)
+{
+   const __m512i allSquares  = _mm512_set1_epi32(params.allSquares);
+   const __m512i notRightCol = _mm512_set1_epi32(params.notRightCol);
+   const __m512i notLeftCol  = _mm512_set1_epi32(params.notLeftCol);
+   const __m128i shiftPlayer = _mm_cvtsi32_si128(params.numSquares);
+   const __m128i shiftPush   = _mm_cvtsi32_si128(params.numCols);
+   const __m128i shiftRight  = _mm_cvtsi32_si128(params.numCols-1);
+   const __m128i shiftLeft   = _mm_cvtsi32_si128(params.numCols+1);
+   const __mmask16 allLanes  = 0xFFFF;   // See above.
+
+   int i = 0;
+   for (; i+16 <= count; i += 16) {
+      __m512i position = _mm512_loadu_si512(positions+i);
+      __m512i occupied = _mm512_and_si512(position, allSquares);
+      __m512i player   = _mm512_maskz_srl_epi32(allLanes, position, shiftPlayer);
+      __m512i opponent = _mm512_maskz_andnot_epi32(allLanes, player, occupied);
+
+      __m512i p = _mm512_maskz_andnot_epi32(allLanes, _mm512_maskz_sll_epi32(allLanes, occupied, shiftPush), player);
+      __m512i r = _mm512_and_si512(_mm512_and_si512(player, notRightCol), _mm512_maskz_sll_epi32(allLanes, opponent, shiftRight));
+      __m512i l = _mm512_and_si512(_mm512_and_si512(player, notLeftCol), _mm512_maskz_sll_epi32(allLanes, opponent, shiftLeft));
+
+      _mm512_storeu_si512(push+i, p);
+      _mm512_storeu_si512(right+i, r);
+      _mm512_storeu_si512(left+i, l);
+   }
+   return i;
+} // sources32Avx512
+
+__attribute__((target("avx2")))
+static int sources64Avx2(const uint64_t *positions, int count, const MovegenParams& params,
+      uint64_t *push, uint64_t *right, uint64_t *left)
+{
+   const __m256i allSquares  = _mm256_set1_epi64x(params.allSquares);
+   const __m256i notRightCol = _mm256_set1_epi64x(params.notRightCol);
+   const __m256i notLeftCol  = _mm256_set1_epi64x(params.notLeftCol);
+   const __m128i shiftPlayer = _mm_cvtsi32_si128(params.numSquares);
+   const __m128i shiftPush   = _mm_cvtsi32_si128(params.numCols);
+   const __m128i shiftRight  = _mm_cvtsi32_si128(params.numCols-1);
+   const __m128i shiftLeft   = _mm_cvtsi32_si128(params.numCols+1);
+
+   int i = 0;
+   for (; i+4 <= count; i += 4) {
+      __m256i position = _mm256_loadu_si256((const __m256i *) (positions+i));
+      __m256i occupied = _mm256_and_si256(position, allSquares);
+      __m256i player   = _mm256_srl_epi64(position, shiftPlayer);
+      __m256i opponent = _mm256_andnot_si256(player, occupied);
+
+      __m256i p = _mm256_andnot_si256(_mm256_sll_epi64(occupied, shiftPush), player);
+      __m256i r = _mm256_and_si256(_mm256_and_si256(player, notRightCol), _mm256_sll_epi64(opponent, shiftRight));
+      __m256i l = _mm256_and_si256(_mm256_and_si256(player, notLeftCol), _mm256_sll_epi64(opponent, shiftLeft));
+
+      _mm256_storeu_si256((__m256i *) (push+i), p);
+      _mm256_storeu_si256((__m256i *) (right+i), r);
+      _mm256_storeu_si256((__m256i *) (left+i), l);
+   }
+   return i;
+} // sources64Avx2
+
+__attribute__((target("avx512f")))
+static int sources64Avx512(const uint64_t *positions, int count, const MovegenParams& params,
+      uint64_t *push, uint64_t *right, uint64_t *left)
+{
+   const __m512i allSquares  = _mm512_set1_epi64(params.allSquares);
+   const __m512i notRightCol = _mm512_set1_epi64(params.notRightCol);
+   const __m512i notLeftCol  = _mm512_set1_epi64(params.notLeftCol);
+   const __m128i shiftPlayer = _mm_cvtsi32_si128(params.numSquares);
+   const __m128i shiftPush   = _mm_cvtsi32_si128(params.numCols);
+   const __m128i shiftRight  = _mm_cvtsi32_si128(params.numCols-1);
+   const __m128i shiftLeft   = _mm_cvtsi32_si128(params.numCols+1);
+   const __mmask8  allLanes  = 0xFF;     // See above.
+
+   int i = 0;
+   for (; i+8 <= count; i += 8) {
+      __m512i position = _mm512_loadu_si512(positions+i);
+      __m512i occupied = _mm512_and_si512(position, allSquares);
+      __m512i player   = _mm512_maskz_srl_epi64(allLanes, position, shiftPlayer);
+      __m512i opponent = _mm512_maskz_andnot_epi64(allLanes, player, occupied);
+
+      __m512i p = _mm512_maskz_andnot_epi64(allLanes, _mm512_maskz_sll_epi64(allLanes, occupied, shiftPush), player);
+      __m512i r = _mm512_and_si512(_mm512_and_si512(player, notRightCol), _mm512_maskz_sll_epi64(allLanes, opponent, shiftRight));
+      __m512i l = _mm512_and_si512(_mm512_and_si512(player, notLeftCol), _mm512_maskz_sll_epi64(allLanes, opponent, shiftLeft));
+
+      _mm512_storeu_si512(push+i, p);
+      _mm512_storeu_si512(right+i, r);
+      _mm512_storeu_si512(left+i, l);
+   }
+   return i;
+} // sources64Avx512
+
+int movegenSources32(const uint32_t *positions, int count, const MovegenParams& params,
+      uint32_t *push, uint32_t *right, uint32_t *left)
+{
+   switch (movegenLevel())
+   {
+      case MOVEGEN_AVX512 : return sources32Avx512(positions, count, params, push, right, left);
+      case MOVEGEN_AVX2   : return sources32Avx2(positions, count, params, push, right, left);
+      default             : return 0;
+   }
+} // movegenSources32
+
+int movegenSources64(const uint64_t *positions, int count, const MovegenParams& params,
+      uint64_t *push, uint64_t *right, uint64_t *left)
+{
+   switch (movegenLevel())
+   {
+      case MOVEGEN_AVX512 : return sources64Avx512(positions, count, params, push, right, left);
+      case MOVEGEN_AVX2   : return sources64Avx2(positions, count, params, push, right, left);
+      default             : return 0;
+   }
+} // movegenSources64
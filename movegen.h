@@ -0,0 +1,110 @@
+#ifndef _TOUCHDOWN_MOVEGEN_H
+#define _TOUCHDOWN_MOVEGEN_H
+
+#include <stdint.h>
+#include "board.h"
+
+// Batched move generation. Board::getMoveSources only uses shifts and masks,
+// so it can be evaluated for a whole batch of positions at once, using the
+// vector units of the CPU. The vector code is selected at runtime, depending
+// on whether the CPU supports AVX-512 or AVX2. On other CPUs, and on boards
+// with more than 32 squares, the scalar code is used.
+
+// The board geometry used by the vector code.
+struct MovegenParams
+{
+   int      numSquares;
+   int      numCols;
+   uint64_t allSquares;
+   uint64_t notRightCol;
+   uint64_t notLeftCol;
+}; // MovegenParams
+
+// These functions calculate the move sources (see Board::getMoveSources) for
+// as many of the count positions as the vector units can handle, and return
+// the number of positions processed. The remaining positions must be handled
+// by the caller. They return zero, if the CPU has no suitable vector unit.
+int movegenSources32(const uint32_t *positions, int count, const MovegenParams& params,
+      uint32_t *push, uint32_t *right, uint32_t *left);
+int movegenSources64(const uint64_t *positions, int count, const MovegenParams& params,
+      uint64_t *push, uint64_t *right, uint64_t *left);
+
+// Returns the name of the vector unit used, e.g. "avx2".
+const char *movegenName();
+
+// Collects a batch of positions, and generates the legal moves of all of
+// them in one go.
+template <typename BoardType>
+class MoveBatch
+{
+   public:
+      typedef typename BoardType::Position Position;
+
+      static const int cSize = 64;
+
+      MoveBatch() : m_count(0) {}
+
+      // Add a position to the batch. Returns true when the batch is full.
+      bool add(uint64_t index, Position position) {
+         assert (m_count < cSize);
+         m_index[m_count]    = index;
+         m_position[m_count] = position;
+         return ++m_count == cSize;
+      }
+
+      int count() const { return m_count; }
+      uint64_t index(int i) const { return m_index[i]; }
+
+      // Calculate the move sources of all positions in the batch.
+      void generate() {
+         const MovegenParams params = {
+            BoardType::cNumSquares,
+            BoardType::cNumCols,
+            BoardType::cAllSquares,
+            BoardType::cAllSquares & ~BoardType::cRightCol,
+            BoardType::cAllSquares & ~BoardType::cLeftCol
+         };
+
+         int done = 0;
+         if (sizeof(Position) == sizeof(uint32_t)) {
+            done = movegenSources32((const uint32_t *) m_position, m_count, params,
+                  (uint32_t *) m_push, (uint32_t *) m_right, (uint32_t *) m_left);
+         } else if (sizeof(Position) == sizeof(uint64_t)) {
+            done = movegenSources64((const uint64_t *) m_position, m_count, params,
+                  (uint64_t *) m_push, (uint64_t *) m_right, (uint64_t *) m_left);
+         }
+
+         // Scalar code for the rest.
+         for (int i=done; i<m_count; ++i) {
+            typename BoardType::Squares push;
+            typename BoardType::Squares right;
+            typename BoardType::Squares left;
+            BoardType::getMoveSources(m_position[i], push, right, left);
+            m_push[i]  = push;
+            m_right[i] = right;
+            m_left[i]  = left;
+         }
+      } // generate
+
+      // Generate the legal moves of position number i in the batch. This
+      // must be called after generate.
+      int writeLegalMoves(int i, BoardType& board, Position legalMoves[BoardType::cMaxMoves]) const {
+         board.setPosition(m_position[i]);
+         return board.writeLegalMoves(m_push[i], m_right[i], m_left[i], legalMoves);
+      }
+
+      void clear() { m_count = 0; }
+
+   private:
+      int      m_count;
+      uint64_t m_index[cSize];
+      Position m_position[cSize];
+
+      // The move sources are stored with the same width as the positions,
+      // which is the width used by the vector code.
+      Position m_push[cSize];
+      Position m_right[cSize];
+      Position m_left[cSize];
+}; // MoveBatch
+
+#endif // _TOUCHDOWN_MOVEGEN_H
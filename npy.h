@@ -0,0 +1,85 @@
+#ifndef _TOUCHDOWN_NPY_H
+#define _TOUCHDOWN_NPY_H
+
+#include <string>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <assert.h>
+
+// A NumPy array file (.npy, format version 1.0) of unsigned bytes, with
+// either one dimension (numCols is zero) or two. The file is created with its
+// final size, and the array data is mapped to memory, so the rows can be
+// filled in by several threads, in any order. numpy.load reads the file
+// directly, or memory maps it with mmap_mode='r'.
+class NpyFile
+{
+   public:
+      NpyFile(const std::string& fileName, uint64_t numRows, uint64_t numCols = 0)
+      {
+         // The header is a Python dictionary literal, padded with spaces and
+         // ended by a newline, so the data starts on a 64 byte boundary.
+         std::string shape = numCols ? "(" + std::to_string(numRows) + ", " + std::to_string(numCols) + ")"
+                                     : "(" + std::to_string(numRows) + ",)";
+         std::string header = "{'descr': '|u1', 'fortran_order': False, 'shape': " + shape + ", }";
+         size_t headerSize = (cPreambleSize + header.size() + 1 + 63) / 64 * 64;
+         header.resize(headerSize - cPreambleSize - 1, ' ');
+         header += '\n';
+
+         m_dataOffset = headerSize;
+         m_size       = headerSize + numRows * (numCols ? numCols : 1);
+
+         m_fd = open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+         if (m_fd < 0)
+         {
+            perror("open");
+            assert (false);
+         }
+
+         if (posix_fallocate(m_fd, 0, m_size)) // Make sure new file has the right size
+         {
+            perror("fallocate");
+            assert (false);
+         }
+
+         m_file = (uint8_t *) mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+         if (m_file == MAP_FAILED) // Map the file to a pointer
+         {
+            perror("mmap");
+            assert (false);
+         }
+
+         uint16_t headerLength = header.size();
+         memcpy(m_file, "\x93NUMPY\x01\x00", 8);
+         m_file[8] = headerLength & 0xFF;
+         m_file[9] = headerLength >> 8;
+         memcpy(m_file + cPreambleSize, header.data(), header.size());
+      }
+
+      ~NpyFile()
+      {
+         munmap(m_file, m_size);
+         close(m_fd);
+      }
+
+      // Return the array data, in row major order.
+      uint8_t *data() {
+         return m_file + m_dataOffset;
+      }
+
+   private:
+      static const size_t cPreambleSize = 10;   // Magic string, version, and header length.
+
+      uint8_t *m_file;
+      size_t   m_size;         // Size of file in bytes.
+      size_t   m_dataOffset;
+      int      m_fd;
+
+}; // NpyFile
+
+#endif // _TOUCHDOWN_NPY_H
@@ -0,0 +1,44 @@
+#ifndef _TOUCHDOWN_PARALLEL_H
+#define _TOUCHDOWN_PARALLEL_H
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+// Split the range [0, size) into chunks of chunkSize values, and let
+// numThreads worker threads process the chunks. The chunks are handed out
+// dynamically, so a thread that finishes early just grabs the next chunk.
+// The function is called as func(threadNum, begin, end) for each chunk.
+// With a single thread everything runs in the calling thread.
+template <typename Func>
+void parallelFor(int numThreads, uint64_t size, uint64_t chunkSize, Func func)
+{
+   std::atomic<uint64_t> nextChunk(0);
+
+   auto worker = [&](int threadNum) {
+      while (true) {
+         uint64_t begin = nextChunk.fetch_add(chunkSize, std::memory_order_relaxed);
+         if (begin >= size) {
+            break;
+         }
+         uint64_t end = begin + chunkSize < size ? begin + chunkSize : size;
+         func(threadNum, begin, end);
+      }
+   };
+
+   if (numThreads <= 1) {
+      worker(0);
+      return;
+   }
+
+   std::vector<std::thread> threads;
+   for (int i=0; i<numThreads; ++i) {
+      threads.emplace_back(worker, i);
+   }
+   for (auto& thread : threads) {
+      thread.join();
+   }
+} // parallelFor
+
+#endif // _TOUCHDOWN_PARALLEL_H
@@ -0,0 +1,203 @@
+#ifndef _TOUCHDOWN_PERFT_H
+#define _TOUCHDOWN_PERFT_H
+
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+#include "board.h"
+#include "parallel.h"
+
+// A fixed size cache of the leaf counts of subtrees, shared by the perft
+// threads without any locks, like TranspositionTable in search.h. Each entry
+// is the hash key, stored XOR'ed with the data, and the data, which is the
+// count shifted left by one, with the low bit set to tell it from an empty
+// entry.
+class PerftCache
+{
+   public:
+      // The number of entries is the largest power of two that fits in
+      // sizeMB megabytes. A size of zero disables the cache.
+      PerftCache(size_t sizeMB) : m_mask(0) {
+         if (!sizeMB) {
+            return;
+         }
+         size_t numEntries = 1;
+         while (2 * numEntries * sizeof(Slot) <= (sizeMB << 20)) {
+            numEntries *= 2;
+         }
+         m_slots.resize(numEntries);
+         m_mask = numEntries - 1;
+      }
+
+      bool enabled() const {
+         return !m_slots.empty();
+      }
+
+      bool probe(uint64_t key, uint64_t& count) const {
+         const Slot& slot = m_slots[key & m_mask];
+         uint64_t data = __atomic_load_n(&slot.data, __ATOMIC_RELAXED);
+         if ((__atomic_load_n(&slot.key, __ATOMIC_RELAXED) ^ data) != key || !(data & 1)) {
+            return false;
+         }
+         count = data >> 1;
+         return true;
+      } // probe
+
+      void store(uint64_t key, uint64_t count) {
+         Slot& slot = m_slots[key & m_mask];
+         uint64_t data = count << 1 | 1;
+         __atomic_store_n(&slot.key, key ^ data, __ATOMIC_RELAXED);
+         __atomic_store_n(&slot.data, data, __ATOMIC_RELAXED);
+      } // store
+
+   private:
+      struct Slot {
+         uint64_t key  = 0;
+         uint64_t data = 0;
+      }; // Slot
+
+      std::vector<Slot> m_slots;
+      uint64_t          m_mask;
+}; // PerftCache
+
+// The result of a perft run.
+template <typename BoardType>
+struct PerftResult
+{
+   std::vector<typename BoardType::Position> moves;    // As returned by writeLegalMoves.
+   std::vector<uint64_t>                     counts;   // Leaf nodes below each move.
+   uint64_t nodes;                                     // Leaf nodes in total.
+   uint64_t cacheHits;
+   double   seconds;
+}; // PerftResult
+
+// Count the leaf nodes of the game tree to a fixed depth ("perft"), i.e. the
+// number of move sequences of exactly that many plies. A game that ends
+// earlier adds nothing. The counts only depend on writeLegalMoves and
+// swapPosition, so they check any change of the move generation, and the
+// time taken measures its speed.
+//
+// The moves of the last ply are counted from Board::getMoveSources, without
+// generating them. Subtrees of at least two plies are looked up in the cache,
+// if it is enabled, as the same position is reached by many move orders.
+// With more than one thread, the first plies are expanded until there are
+// enough subtrees to keep the threads busy, and the subtrees are counted in
+// parallel.
+template <typename BoardType>
+class Perft
+{
+   public:
+      typedef typename BoardType::Position Position;
+      typedef typename BoardType::Squares  Squares;
+
+      Perft(int numThreads, size_t cacheSizeMB)
+         : m_numThreads(numThreads < 1 ? 1 : numThreads), m_cache(cacheSizeMB)
+      {
+      }
+
+      PerftResult<BoardType> run(const BoardType& board, int depth) {
+         Clock::time_point start = Clock::now();
+
+         PerftResult<BoardType> result = {};
+         Position moves[BoardType::cMaxMoves];
+         int moveCount = (depth > 0 && !board.isLoss()) ? board.writeLegalMoves(moves) : 0;
+         result.moves.assign(moves, moves + moveCount);
+         result.counts.assign(moveCount, 0);
+
+         // The subtrees still to be counted, and the move they are below.
+         std::vector<Subtree> subtrees;
+         for (int i = 0; i < moveCount; ++i) {
+            subtrees.push_back({i, moves[i]});
+         }
+         int remaining = depth - 1;
+         while (m_numThreads > 1 && remaining > 1 && subtrees.size() < cSubtreesPerThread * m_numThreads) {
+            std::vector<Subtree> expanded;
+            for (const Subtree& subtree : subtrees) {
+               BoardType child;
+               child.setPosition(subtree.position);
+               if (child.isLoss()) {
+                  continue;
+               }
+               int childCount = child.writeLegalMoves(moves);
+               for (int i = 0; i < childCount; ++i) {
+                  expanded.push_back({subtree.move, moves[i]});
+               }
+            }
+            subtrees.swap(expanded);
+            --remaining;
+         }
+
+         std::vector<std::atomic<uint64_t>> counts(moveCount);
+         std::atomic<uint64_t> cacheHits(0);
+         parallelFor(m_numThreads, subtrees.size(), 1, [&](int, uint64_t begin, uint64_t end) {
+            uint64_t hits = 0;
+            for (uint64_t i = begin; i < end; ++i) {
+               counts[subtrees[i].move] += count(subtrees[i].position, remaining, hits);
+            }
+            cacheHits += hits;
+         });
+
+         for (int i = 0; i < moveCount; ++i) {
+            result.counts[i] = counts[i];
+            result.nodes += result.counts[i];
+         }
+         if (depth == 0) {
+            result.nodes = 1;
+         }
+         result.cacheHits = cacheHits;
+         result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+         return result;
+      } // run
+
+      // Return the number of leaf nodes depth plies below a position.
+      uint64_t count(Position position, int depth, uint64_t& cacheHits) {
+         if (depth == 0) {
+            return 1;
+         }
+         BoardType board;
+         board.setPosition(position);
+         if (board.isLoss()) {
+            return 0;
+         }
+         if (depth == 1) {
+            Squares push;
+            Squares right;
+            Squares left;
+            BoardType::getMoveSources(position, push, right, left);
+            return __builtin_popcountll(push) + __builtin_popcountll(right) + __builtin_popcountll(left);
+         }
+
+         uint64_t key = BoardType::hashPosition(position) ^ depth * 0x9E3779B97F4A7C15;
+         uint64_t nodes = 0;
+         if (m_cache.enabled() && m_cache.probe(key, nodes)) {
+            ++cacheHits;
+            return nodes;
+         }
+
+         Position moves[BoardType::cMaxMoves];
+         int moveCount = board.writeLegalMoves(moves);
+         for (int i = 0; i < moveCount; ++i) {
+            nodes += count(moves[i], depth - 1, cacheHits);
+         }
+         if (m_cache.enabled()) {
+            m_cache.store(key, nodes);
+         }
+         return nodes;
+      } // count
+
+   private:
+      typedef std::chrono::steady_clock Clock;
+
+      static const size_t cSubtreesPerThread = 16;
+
+      struct Subtree {
+         int      move;   // Index of the root move.
+         Position position;
+      }; // Subtree
+
+      int        m_numThreads;
+      PerftCache m_cache;
+}; // Perft
+
+#endif // _TOUCHDOWN_PERFT_H
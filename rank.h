@@ -0,0 +1,176 @@
+#ifndef _TOUCHDOWN_RANK_H
+#define _TOUCHDOWN_RANK_H
+
+#include <stdint.h>
+#include <assert.h>
+#include "index.h"
+
+// This is an alternative to the 24-bit index value described in index.h.
+// It numbers only the legal board positions, using the combinatorial number
+// system (option 3 in the README).
+//
+// The positions are grouped into material classes, according to the number
+// of player pawns (np) and opponent pawns (no). Within a class:
+// * The player pawns are placed on the squares outside the first row (row 0),
+//   because a player pawn on the first row is an illegal position.
+// * The opponent pawns are placed on any of the squares not occupied by a
+//   player pawn. At least one opponent pawn must be present, because
+//   otherwise the position is illegal too.
+//
+// Each placement of k pawns on n squares is a k-bit subset of an n-bit
+// mask, and is numbered from 0 to B(n,k)-1 in co-lexicographic order, i.e.
+// by the sum of B(p_i, i+1), where p_i is the bit number of the i'th pawn.
+// Co-lexicographic order is the same as the numerical order of the masks.
+//
+// The rank value of a position is then:
+//    offset(np, no) + rankPlayer * B(n-np, no) + rankOpponent
+// where n is the number of squares. The classes are ordered by np first,
+// then by no.
+//
+// On the 4x4 board this gives exactly 755591 rank values, one for each
+// legal position, compared to the 2^24 index values.
+
+template <int tNumRows, int tNumCols>
+class Rank
+{
+   public:
+      static const int cNumSquares       = tNumRows * tNumCols;
+      static const int cNumPawns         = tNumCols;
+      static const int cNumPlayerSquares = cNumSquares - tNumCols;
+
+      static constexpr uint64_t cAllSquares = (cNumSquares == 64) ? ~(uint64_t) 0 : ((uint64_t) 1 << cNumSquares) - 1;
+
+      // Return the total number of rank values.
+      static uint64_t size() {
+         return table().m_offset[cNumPawns+1][0];
+      }
+
+      // Return the first rank value of a given material class.
+      static uint64_t classOffset(int numPlayer, int numOpponent) {
+         return table().m_offset[numPlayer][numOpponent-1];
+      }
+
+      // Return the number of rank values in a given material class.
+      static uint64_t classSize(int numPlayer, int numOpponent) {
+         return binomial(cNumPlayerSquares, numPlayer) * binomial(cNumSquares-numPlayer, numOpponent);
+      }
+
+      static uint64_t binomial(int n, int k) {
+         if (k < 0 || k > n)
+            return 0;
+         return table().m_binomial[n][k];
+      }
+
+      // Return the co-lexicographic number of the subset given by mask.
+      static uint64_t rankSubset(uint64_t mask) {
+         uint64_t rank = 0;
+         for (int i=1; mask; ++i) {
+            rank += binomial(__builtin_ctzll(mask), i);
+            mask &= mask - 1;
+         }
+         return rank;
+      } // rankSubset
+
+      // Return the subset of count bits with the given co-lexicographic number.
+      static uint64_t unrankSubset(uint64_t rank, int count) {
+         uint64_t mask = 0;
+         int bit = cNumSquares;
+         for (int i=count; i>0; --i) {
+            // Find the largest bit number with B(bit, i) <= rank.
+            do {
+               --bit;
+            } while (binomial(bit, i) > rank);
+            rank -= binomial(bit, i);
+            mask |= (uint64_t) 1 << bit;
+         }
+         assert (rank == 0);
+         return mask;
+      } // unrankSubset
+
+      // Return the rank value of the position with the given pawns.
+      static uint64_t rank(uint64_t player, uint64_t opponent) {
+         int numPlayer   = __builtin_popcountll(player);
+         int numOpponent = __builtin_popcountll(opponent);
+
+         return classOffset(numPlayer, numOpponent) + rankInClass(player, opponent);
+      } // rank
+
+      // Return the pawns of the position with the given rank value.
+      static void unrank(uint64_t rank, uint64_t& player, uint64_t& opponent) {
+         assert (rank < size());
+
+         // Find the material class.
+         int numPlayer   = 0;
+         int numOpponent = 1;
+         while (table().m_offset[numPlayer+1][0] <= rank) {
+            ++numPlayer;
+         }
+         while (numOpponent < cNumPawns && classOffset(numPlayer, numOpponent+1) <= rank) {
+            ++numOpponent;
+         }
+
+         unrankInClass(numPlayer, numOpponent, rank - classOffset(numPlayer, numOpponent), player, opponent);
+      } // unrank
+
+      // Return the rank value of the position relative to the first rank
+      // value of its material class.
+      static uint64_t rankInClass(uint64_t player, uint64_t opponent) {
+         int numPlayer   = __builtin_popcountll(player);
+         int numOpponent = __builtin_popcountll(opponent);
+         assert (numPlayer <= cNumPawns);
+         assert (numOpponent >= 1 && numOpponent <= cNumPawns);
+         assert (!(player & ((1 << tNumCols) - 1)));
+
+         uint64_t rankPlayer   = rankSubset(player >> tNumCols);
+         uint64_t rankOpponent = rankSubset(indexExtractBits(opponent, cAllSquares & ~player));
+
+         return rankPlayer * binomial(cNumSquares-numPlayer, numOpponent) + rankOpponent;
+      } // rankInClass
+
+      // Return the pawns of the position in the given material class with
+      // the given relative rank value.
+      static void unrankInClass(int numPlayer, int numOpponent, uint64_t rank, uint64_t& player, uint64_t& opponent) {
+         assert (rank < classSize(numPlayer, numOpponent));
+
+         uint64_t numOpponentPlacements = binomial(cNumSquares-numPlayer, numOpponent);
+
+         player   = unrankSubset(rank / numOpponentPlacements, numPlayer) << tNumCols;
+         opponent = indexDepositBits(unrankSubset(rank % numOpponentPlacements, numOpponent), cAllSquares & ~player);
+      } // unrankInClass
+
+   private:
+      // The tables are calculated once, on first use.
+      struct Table {
+         Table() {
+            for (int n=0; n<=cNumSquares; ++n) {
+               m_binomial[n][0] = 1;
+               for (int k=1; k<=n; ++k) {
+                  m_binomial[n][k] = m_binomial[n-1][k-1] + (k < n ? m_binomial[n-1][k] : 0);
+               }
+            }
+
+            // m_offset[np][no-1] is the first rank value with np player pawns
+            // and no opponent pawns. The entry m_offset[np+1][0] follows the
+            // last class with np player pawns.
+            uint64_t offset = 0;
+            for (int np=0; np<=cNumPawns; ++np) {
+               for (int no=1; no<=cNumPawns; ++no) {
+                  m_offset[np][no-1] = offset;
+                  offset += m_binomial[cNumPlayerSquares][np] * m_binomial[cNumSquares-np][no];
+               }
+            }
+            m_offset[cNumPawns+1][0] = offset;
+         }
+
+         uint64_t m_binomial[cNumSquares+1][cNumSquares+1] = {};
+         uint64_t m_offset[cNumPawns+2][cNumPawns] = {};
+      }; // Table
+
+      static const Table& table() {
+         static const Table s_table;
+         return s_table;
+      }
+}; // class Rank
+
+#endif // _TOUCHDOWN_RANK_H
+
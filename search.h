@@ -0,0 +1,409 @@
+#ifndef _TOUCHDOWN_SEARCH_H
+#define _TOUCHDOWN_SEARCH_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <stdint.h>
+#include <sys/stat.h>
+#include "board.h"
+#include "slice.h"
+#include "tablebase.h"
+
+// The material slices of a database (see slice.h), e.g. "touchdown.tb.2-1",
+// that are present on disk. Slices are generated in order of increasing
+// number of pawns, so on a board that is too large to be solved completely,
+// the slices with few pawns may still be available.
+template <int tNumRows, int tNumCols>
+class SliceTables
+{
+   public:
+      typedef Board<tNumRows, tNumCols>         BoardType;
+      typedef MaterialSlice<tNumRows, tNumCols> Slice;
+
+      // Open all the slices of the database baseName that exist. If baseName
+      // is empty, there are no slices.
+      SliceTables(const std::string& baseName) : m_tables(Slice::cNumIds), m_count(0)
+      {
+         if (baseName.empty()) {
+            return;
+         }
+         for (int numMost = 1; numMost <= BoardType::cNumPawns; ++numMost) {
+            for (int numLeast = 0; numLeast <= numMost; ++numLeast) {
+               Slice slice(numMost, numLeast);
+               struct stat st;
+               if (stat(slice.fileName(baseName).c_str(), &st) || st.st_size < (ssize_t) (slice.size() + 7) / 8) {
+                  continue;
+               }
+               m_tables[slice.id()].reset(new TableBase(slice.fileName(baseName), slice.size(), TableBase::ReadOnly));
+               ++m_count;
+            }
+         }
+      }
+
+      // Return the number of slices available.
+      int count() const {
+         return m_count;
+      }
+
+      // Look up a legal position. Returns false if its slice is not available.
+      bool probe(const BoardType& board, bool& isWin) const {
+         Slice slice = Slice::fromBoard(board);
+         const TableBase *table = m_tables[slice.id()].get();
+         if (!table) {
+            return false;
+         }
+         isWin = table->readBit(slice.index(board));
+         return true;
+      } // probe
+
+   private:
+      std::vector<std::unique_ptr<TableBase>> m_tables;
+      int                                     m_count;
+}; // SliceTables
+
+// A fixed size transposition table, shared by all the search threads without
+// any locks. Each entry is two 64-bit words, the hash key and the data, and
+// the key is stored XOR'ed with the data. A reader that sees the two words
+// from different writes finds that the key does not match, and just treats it
+// as a miss.
+class TranspositionTable
+{
+   public:
+      enum Bound {
+         None  = 0,   // Empty entry.
+         Exact = 1,
+         Lower = 2,   // The score is at least this.
+         Upper = 3    // The score is at most this.
+      };
+
+      struct Entry {
+         int   score;
+         int   depth;
+         Bound bound;
+         int   move;   // Index of the best move, in the order of Board::writeLegalMoves.
+      }; // Entry
+
+      // The number of entries is the largest power of two that fits in
+      // sizeMB megabytes.
+      TranspositionTable(size_t sizeMB) {
+         size_t numEntries = 1;
+         while (2 * numEntries * sizeof(Slot) <= (sizeMB << 20)) {
+            numEntries *= 2;
+         }
+         m_slots.resize(numEntries);
+         m_mask = numEntries - 1;
+      }
+
+      bool probe(uint64_t key, Entry& entry) const {
+         const Slot& slot = m_slots[key & m_mask];
+         uint64_t data = __atomic_load_n(&slot.data, __ATOMIC_RELAXED);
+         if ((__atomic_load_n(&slot.key, __ATOMIC_RELAXED) ^ data) != key || (data >> 24 & 3) == None) {
+            return false;
+         }
+         entry.score = (int16_t) (data & 0xFFFF);
+         entry.depth = (data >> 16) & 0xFF;
+         entry.bound = (Bound) ((data >> 24) & 3);
+         entry.move  = (data >> 32) & 0xFF;
+         return true;
+      } // probe
+
+      // An entry of another position is always replaced, and an entry of
+      // the same position only by a search that is at least as deep.
+      void store(uint64_t key, int score, int depth, Bound bound, int move) {
+         Slot& slot = m_slots[key & m_mask];
+         uint64_t old = __atomic_load_n(&slot.data, __ATOMIC_RELAXED);
+         if ((__atomic_load_n(&slot.key, __ATOMIC_RELAXED) ^ old) == key && (int) ((old >> 16) & 0xFF) > depth) {
+            return;
+         }
+         uint64_t data = (uint16_t) score | (uint64_t) depth << 16 | (uint64_t) bound << 24 | (uint64_t) move << 32;
+         __atomic_store_n(&slot.key, key ^ data, __ATOMIC_RELAXED);
+         __atomic_store_n(&slot.data, data, __ATOMIC_RELAXED);
+      } // store
+
+   private:
+      struct Slot {
+         uint64_t key  = 0;
+         uint64_t data = 0;
+      }; // Slot
+
+      std::vector<Slot> m_slots;
+      uint64_t          m_mask;
+}; // TranspositionTable
+
+// The result of a search.
+template <typename BoardType>
+struct SearchResult
+{
+   int      score;     // From the view of the player to move, see Search.
+   int      depth;     // Depth of the last completed iteration.
+   int      moveCount;
+   typename BoardType::Position bestMove;  // As returned by writeLegalMoves.
+   uint64_t nodes;
+   uint64_t tableBaseHits;
+   double   seconds;
+}; // SearchResult
+
+// An alpha-beta search, for positions of boards that are too large to be
+// solved completely. It uses iterative deepening, and the moves are tried in
+// the order: best move of the transposition table, captures and killer moves,
+// and then the most advanced pawns. The search stops at positions of the
+// material slices that are available, which are a WIN or a LOSS.
+//
+// The score is from the view of the player to move:
+//    cWin - n          : WIN in n plies.
+//    cTableBaseWin - n : WIN, n plies to a position of a slice that is a WIN.
+//    Less than that    : Not decided, positive scores are good for the player.
+// and the negative of those for a LOSS. Every move advances a pawn, so the
+// search is exact once the depth exceeds the length of the game.
+//
+// With more than one thread, all threads search the same position, and share
+// the transposition table (the "lazy SMP" scheme). Every other helper thread
+// searches one ply deeper, so the threads mostly fill in the table for each
+// other. The result is that of the main thread.
+template <typename BoardType>
+class Search
+{
+   public:
+      typedef typename BoardType::Position Position;
+      typedef typename BoardType::Squares  Squares;
+
+      static const int cMaxPly       = 2 * BoardType::cNumCols * (BoardType::cNumRows-1) + 1;
+      static const int cWin          = 30000;
+      static const int cTableBaseWin = 20000;
+      static const int cInfinity     = 32000;
+
+      Search(const SliceTables<BoardType::cNumRows, BoardType::cNumCols>& slices, TranspositionTable& tt, int numThreads)
+         : m_slices(slices), m_tt(tt), m_numThreads(numThreads < 1 ? 1 : numThreads)
+      {
+      }
+
+      // Return true if a score is a decided WIN or LOSS.
+      static bool isDecided(int score) {
+         return score > cTableBaseWin - cMaxPly || score < -(cTableBaseWin - cMaxPly);
+      }
+
+      // Search a legal position for at most maxDepth plies (zero for no
+      // limit), and at most milliseconds (zero for no limit). The search
+      // also stops as soon as the position is decided.
+      SearchResult<BoardType> run(const BoardType& board, int maxDepth, int milliseconds) {
+         Clock::time_point start = Clock::now();
+         m_deadline = start + std::chrono::milliseconds(milliseconds);
+         m_hasDeadline = milliseconds > 0;
+         m_stop = false;
+         if (maxDepth <= 0 || maxDepth > cMaxPly) {
+            maxDepth = cMaxPly;
+         }
+
+         SearchResult<BoardType> result = {};
+         std::vector<Worker> workers(m_numThreads);
+         std::vector<std::thread> helpers;
+         for (int i = 1; i < m_numThreads; ++i) {
+            workers[i].id = i;
+            helpers.emplace_back([&, i]() {
+               searchRoot(workers[i], board, maxDepth, nullptr);
+            });
+         }
+         searchRoot(workers[0], board, maxDepth, &result);
+         m_stop = true;
+         for (auto& helper : helpers) {
+            helper.join();
+         }
+
+         for (const Worker& worker : workers) {
+            result.nodes         += worker.nodes;
+            result.tableBaseHits += worker.tableBaseHits;
+         }
+         result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+         return result;
+      } // run
+
+      // Return the hash key of a position.
+      static uint64_t hash(Position position) {
+         return BoardType::hashPosition(position);
+      }
+
+   private:
+      typedef std::chrono::steady_clock Clock;
+
+      // The state of each search thread.
+      struct Worker {
+         int      id = 0;
+         uint64_t nodes = 0;
+         uint64_t tableBaseHits = 0;
+         int      rootMove = 0;   // Index of the best move of the last search of the root.
+         Position killers[cMaxPly+1][2] = {};
+      }; // Worker
+
+      // The iterative deepening of one thread. The main thread stores the
+      // result of each completed iteration in result.
+      void searchRoot(Worker& worker, const BoardType& board, int maxDepth, SearchResult<BoardType> *result) {
+         Position moves[BoardType::cMaxMoves];
+         int moveCount = board.isLoss() ? 0 : board.writeLegalMoves(moves);
+         if (result) {
+            result->moveCount = moveCount;
+            result->score     = -cWin;
+            result->bestMove  = moveCount ? moves[0] : 0;
+         }
+         if (!moveCount) {
+            return;
+         }
+
+         for (int depth = 1 + (worker.id & 1); depth <= maxDepth && !m_stop; ++depth) {
+            int score = alphaBeta(worker, board, depth, 0, -cInfinity, cInfinity);
+            if (m_stop || !result) {
+               continue;
+            }
+
+            result->bestMove = moves[worker.rootMove];
+            result->score    = score;
+            result->depth = depth;
+            if (isDecided(score)) {
+               break;
+            }
+         }
+      } // searchRoot
+
+      // Return the score of the position, as seen by the player to move,
+      // searching depth plies further. The position is ply plies from the
+      // root. The score is exact if it is between alpha and beta.
+      int alphaBeta(Worker& worker, const BoardType& board, int depth, int ply, int alpha, int beta) {
+         if ((++worker.nodes & 0x3FF) == 0 && worker.id == 0 && m_hasDeadline && Clock::now() >= m_deadline) {
+            m_stop = true;
+         }
+         if (m_stop) {
+            return 0;
+         }
+
+         if (board.isLoss()) {
+            return -(cWin - ply);
+         }
+
+         bool isWin;
+         if (ply > 0 && m_slices.probe(board, isWin)) {
+            ++worker.tableBaseHits;
+            return isWin ? cTableBaseWin - ply : -(cTableBaseWin - ply);
+         }
+
+         Position moves[BoardType::cMaxMoves];
+         int moveCount = board.writeLegalMoves(moves);
+         if (!moveCount) {
+            return -(cWin - ply);
+         }
+         if (depth <= 0) {
+            return evaluate(board);
+         }
+
+         uint64_t key = hash(board.getPosition());
+         int ttMove = -1;
+         TranspositionTable::Entry entry;
+         if (m_tt.probe(key, entry)) {
+            ttMove = entry.move;
+            int score = fromTable(entry.score, ply);
+            if (ply > 0 && entry.depth >= depth &&
+                (entry.bound == TranspositionTable::Exact ||
+                 (entry.bound == TranspositionTable::Lower && score >= beta) ||
+                 (entry.bound == TranspositionTable::Upper && score <= alpha))) {
+               return score;
+            }
+         }
+
+         // Order the moves, best first.
+         int keys[BoardType::cMaxMoves];
+         int order[BoardType::cMaxMoves];
+         int numOpponent = __builtin_popcountll(board.getOpponent());
+         for (int i = 0; i < moveCount; ++i) {
+            BoardType child;
+            child.setPosition(moves[i]);
+            keys[i] = -evaluate(child);
+            if (i == ttMove) {
+               keys[i] += 1 << 20;
+            } else if (__builtin_popcountll(child.getPlayer()) < numOpponent) {
+               keys[i] += 1 << 18;   // Capture.
+            } else if (moves[i] == worker.killers[ply][0] || moves[i] == worker.killers[ply][1]) {
+               keys[i] += 1 << 17;
+            }
+            order[i] = i;
+         }
+         for (int i = 1; i < moveCount; ++i) {
+            for (int j = i; j > 0 && keys[order[j]] > keys[order[j-1]]; --j) {
+               std::swap(order[j], order[j-1]);
+            }
+         }
+
+         int originalAlpha = alpha;
+         int bestScore     = -cInfinity;
+         int bestMove      = order[0];
+         for (int i = 0; i < moveCount; ++i) {
+            BoardType child;
+            child.setPosition(moves[order[i]]);
+            int score = -alphaBeta(worker, child, depth-1, ply+1, -beta, -alpha);
+            if (m_stop) {
+               return 0;
+            }
+            if (score > bestScore) {
+               bestScore = score;
+               bestMove  = order[i];
+            }
+            if (score > alpha) {
+               alpha = score;
+            }
+            if (alpha >= beta) {
+               if (keys[order[i]] < (1 << 18)) {
+                  worker.killers[ply][1] = worker.killers[ply][0];
+                  worker.killers[ply][0] = moves[order[i]];
+               }
+               break;
+            }
+         }
+
+         if (ply == 0) {
+            worker.rootMove = bestMove;
+         }
+
+         TranspositionTable::Bound bound = bestScore >= beta          ? TranspositionTable::Lower
+                                         : bestScore <= originalAlpha ? TranspositionTable::Upper
+                                                                      : TranspositionTable::Exact;
+         m_tt.store(key, toTable(bestScore, ply), depth, bound, bestMove);
+         return bestScore;
+      } // alphaBeta
+
+      // A WIN or LOSS is stored in the transposition table relative to the
+      // position, rather than to the root.
+      static int toTable(int score, int ply) {
+         return score > cTableBaseWin - cMaxPly ? score + ply : score < -(cTableBaseWin - cMaxPly) ? score - ply : score;
+      }
+
+      static int fromTable(int score, int ply) {
+         return score > cTableBaseWin - cMaxPly ? score - ply : score < -(cTableBaseWin - cMaxPly) ? score + ply : score;
+      }
+
+      // A static estimate of a position, which is not decided: the material,
+      // and how far the pawns have advanced, with the most advanced pawns
+      // counting the most.
+      static int evaluate(const BoardType& board) {
+         Squares player   = board.getPlayer();
+         Squares opponent = board.getOpponent();
+         int score = 100 * (__builtin_popcountll(player) - __builtin_popcountll(opponent));
+         Squares rowMask = BoardType::cFirstRow;
+         for (int row = 0; row < BoardType::cNumRows; ++row, rowMask <<= BoardType::cNumCols) {
+            int playerAdvance   = BoardType::cNumRows-1 - row;
+            int opponentAdvance = row;
+            score += 4 * playerAdvance * playerAdvance * __builtin_popcountll(player & rowMask);
+            score -= 4 * opponentAdvance * opponentAdvance * __builtin_popcountll(opponent & rowMask);
+         }
+         return score;
+      } // evaluate
+
+      const SliceTables<BoardType::cNumRows, BoardType::cNumCols>& m_slices;
+      TranspositionTable& m_tt;
+      int                 m_numThreads;
+      std::atomic<bool>   m_stop;
+      bool                m_hasDeadline;
+      Clock::time_point   m_deadline;
+}; // Search
+
+#endif // _TOUCHDOWN_SEARCH_H
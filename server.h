@@ -0,0 +1,219 @@
+#ifndef _TOUCHDOWN_SERVER_H
+#define _TOUCHDOWN_SERVER_H
+
+#include <string>
+#include <algorithm>
+#include <vector>
+#include <thread>
+#include <iostream>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <memory>
+#include "tablebase.h"
+#include "distance.h"
+
+// A query server, which maps the database once, and then answers queries
+// about the value of positions, until end of input.
+//
+// Each line of input is one query, and is either:
+// * A board, as written by Board::toShortString, e.g. "...O ..O. .... .XX.".
+//   The spaces are optional.
+// * An index value in hexadecimal, as written by the -c and -d options.
+// Each query is answered by one line of output: "WIN", "LOSS", "ILLEGAL" (for
+// positions that can not occur in a game), or "ERROR" (for malformed queries).
+// If the server uses the distance table (see distance.h), a WIN or LOSS is
+// followed by the number of plies until the end of the game, e.g. "WIN 5".
+//
+// The input is read in large blocks, and all the complete lines in a block
+// are answered as one batch. The database entries of a batch are prefetched
+// before any of them are read, so the lookups overlap each other.
+template <typename Index, typename Table = TableBase>
+class QueryServer
+{
+   public:
+      QueryServer(const char *filename, bool withDistance = false)
+         : m_tb(filename, Index::size(), TableBase::ReadOnly)
+      {
+         if (withDistance) {
+            m_dt.reset(new DistanceTable(DistanceTable::fileName(filename), Index::size(), TableBase::ReadOnly));
+         }
+      }
+
+      // Answer the queries read from inFd, writing the answers to outFd.
+      void serve(int inFd, int outFd) const {
+         std::vector<char> buffer(cBufferSize);
+         size_t used = 0;
+         std::string answers;
+
+         while (true) {
+            ssize_t count = read(inFd, buffer.data() + used, buffer.size() - used);
+            if (count <= 0) {
+               break;
+            }
+            used += count;
+
+            // Answer all complete lines.
+            size_t end = used;
+            while (end > 0 && buffer[end-1] != '\n') {
+               --end;
+            }
+            if (end == 0) {
+               if (used == buffer.size()) {
+                  buffer.resize(2 * buffer.size());    // Very long line.
+               }
+               continue;
+            }
+
+            answers.clear();
+            answerBatch(buffer.data(), end, answers);
+            if (!writeAll(outFd, answers)) {
+               return;
+            }
+
+            std::copy(buffer.begin() + end, buffer.begin() + used, buffer.begin());
+            used -= end;
+         }
+
+         // A final line without newline.
+         if (used > 0) {
+            answers.clear();
+            answerBatch(buffer.data(), used, answers);
+            writeAll(outFd, answers);
+         }
+      } // serve
+
+      // Listen for connections on a Unix domain socket, and serve each
+      // connection in its own thread. This never returns.
+      void listen(const char *socketPath) const {
+         signal(SIGPIPE, SIG_IGN);   // A client going away must not stop the server.
+
+         int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+         if (fd < 0) {
+            perror("socket");
+            assert (false);
+         }
+
+         struct sockaddr_un addr = {};
+         addr.sun_family = AF_UNIX;
+         assert (strlen(socketPath) < sizeof(addr.sun_path));
+         strcpy(addr.sun_path, socketPath);
+         unlink(socketPath);
+
+         if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) || ::listen(fd, SOMAXCONN)) {
+            perror("bind");
+            assert (false);
+         }
+
+         while (true) {
+            int connection = accept(fd, nullptr, nullptr);
+            if (connection < 0) {
+               perror("accept");
+               continue;
+            }
+            std::thread([this, connection]() {
+               serve(connection, connection);
+               close(connection);
+            }).detach();
+         }
+      } // listen
+
+   private:
+      static const size_t cBufferSize = 1 << 16;
+
+      // Convert a query to an index value. Returns false if the query is
+      // malformed. Sets legal to false if the position can not occur in a
+      // game.
+      bool parse(const char *begin, const char *end, uint64_t& index, bool& legal) const {
+         std::string query(begin, end);
+         while (!query.empty() && (query.back() == ' ' || query.back() == '\r')) {
+            query.pop_back();
+         }
+
+         typename Index::BoardType board;
+         if (board.fromShortString(query)) {
+            legal = !board.isWin();
+            if (legal) {
+               index = Index::index(board);
+            }
+            return true;
+         }
+
+         char *parsed;
+         index = strtoull(query.c_str(), &parsed, 16);
+         if (query.empty() || *parsed) {
+            return false;
+         }
+         legal = index < Index::size() && Index::isValid(index) && !Index::board(index).isWin();
+         return true;
+      } // parse
+
+      // Answer all lines in the block [data, data+size).
+      void answerBatch(const char *data, size_t size, std::string& answers) const {
+         enum { ANSWER_ERROR, ANSWER_ILLEGAL, ANSWER_LOOKUP };
+         std::vector<uint64_t> indices;
+         std::vector<int>      kinds;
+
+         // First convert all queries, and prefetch the database entries.
+         const char *begin = data;
+         const char *end   = data + size;
+         while (begin < end) {
+            const char *lineEnd = std::find(begin, end, '\n');
+
+            uint64_t index = 0;
+            bool     legal = false;
+            if (!parse(begin, lineEnd, index, legal)) {
+               kinds.push_back(ANSWER_ERROR);
+            } else if (!legal) {
+               kinds.push_back(ANSWER_ILLEGAL);
+            } else {
+               kinds.push_back(ANSWER_LOOKUP);
+               if (m_dt) {
+                  m_dt->prefetch(index);
+               } else {
+                  m_tb.prefetch(index);
+               }
+            }
+            indices.push_back(index);
+
+            begin = lineEnd + 1;
+         }
+
+         // Then look them up.
+         for (size_t i = 0; i < kinds.size(); ++i) {
+            switch (kinds[i]) {
+               case ANSWER_ERROR   : answers += "ERROR\n"; break;
+               case ANSWER_ILLEGAL : answers += "ILLEGAL\n"; break;
+               default             : answerLookup(indices[i], answers); break;
+            }
+         }
+      } // answerBatch
+
+      void answerLookup(uint64_t index, std::string& answers) const {
+         if (!m_dt) {
+            answers += m_tb.readBit(index) ? "WIN\n" : "LOSS\n";
+            return;
+         }
+         uint8_t value = m_dt->read(index);
+         answers += DistanceTable::isWin(value) ? "WIN " : "LOSS ";
+         answers += std::to_string(DistanceTable::plies(value));
+         answers += "\n";
+      } // answerLookup
+
+      static bool writeAll(int fd, const std::string& data) {
+         size_t done = 0;
+         while (done < data.size()) {
+            ssize_t count = write(fd, data.data() + done, data.size() - done);
+            if (count <= 0) {
+               return false;
+            }
+            done += count;
+         }
+         return true;
+      } // writeAll
+
+      Table                          m_tb;
+      std::unique_ptr<DistanceTable> m_dt;
+}; // QueryServer
+
+#endif // _TOUCHDOWN_SERVER_H
@@ -0,0 +1,110 @@
+#ifndef _TOUCHDOWN_SLICE_H
+#define _TOUCHDOWN_SLICE_H
+
+#include <string>
+#include <assert.h>
+#include "board.h"
+#include "rank.h"
+
+// A material slice holds all legal positions where one player has
+// numMost pawns and the other player has numLeast pawns, regardless of which
+// player is to move. I.e. the slice consists of the two material classes
+// (numMost, numLeast) and (numLeast, numMost) of the rank index, see rank.h.
+// If numMost and numLeast are equal, the slice is just a single class.
+//
+// A move that is not a capture leads to a position in the same slice, and
+// a capture leads to a slice with one pawn less. So the slices can be
+// solved one at a time, in order of increasing number of pawns, and each
+// slice only needs the slices with one pawn less as lookup tables.
+//
+// Within a slice, every move increases the total advancement of the pawns
+// (see Board::getAdvancement), so the positions of a slice can be solved
+// in a single pass, in order of decreasing advancement.
+template <int tNumRows, int tNumCols>
+class MaterialSlice
+{
+   public:
+      typedef Board<tNumRows, tNumCols> BoardType;
+      typedef Rank<tNumRows, tNumCols>  RankType;
+
+      static const int cMaxAdvancement = 2 * tNumCols * (tNumRows-1);
+      static const int cNumIds         = (tNumCols+1) * (tNumCols+1);
+
+      MaterialSlice(int numMost, int numLeast) : m_numMost(numMost), m_numLeast(numLeast)
+      {
+         assert (numMost >= numLeast && numMost > 0 && numMost <= tNumCols);
+
+         // The opponent must have at least one pawn, so if numLeast is zero,
+         // only the second class is present.
+         m_firstSize = (numLeast > 0) ? RankType::classSize(numMost, numLeast) : 0;
+         m_secondSize = (numMost != numLeast) ? RankType::classSize(numLeast, numMost) : 0;
+      }
+
+      // Return the slice holding a given board position.
+      static MaterialSlice fromBoard(const BoardType& board) {
+         int numPlayer   = __builtin_popcountll(board.getPlayer());
+         int numOpponent = __builtin_popcountll(board.getOpponent());
+         if (numPlayer >= numOpponent)
+            return MaterialSlice(numPlayer, numOpponent);
+         return MaterialSlice(numOpponent, numPlayer);
+      } // fromBoard
+
+      int getNumMost() const  { return m_numMost; }
+      int getNumLeast() const { return m_numLeast; }
+
+      // Return a number from 0 to cNumIds-1 identifying the slice.
+      int id() const { return m_numMost * (tNumCols+1) + m_numLeast; }
+
+      // Return the number of positions in the slice.
+      uint64_t size() const {
+         return m_firstSize + m_secondSize;
+      }
+
+      // Return the index value of a board position within the slice. The
+      // positions where the player to move has the most pawns come first.
+      uint64_t index(const BoardType& board) const {
+         uint64_t player   = board.getPlayer();
+         uint64_t opponent = board.getOpponent();
+         assert (fromBoard(board) == *this);
+
+         uint64_t index = RankType::rankInClass(player, opponent);
+         if (__builtin_popcountll(player) != m_numMost) {
+            index += m_firstSize;
+         }
+         return index;
+      } // index
+
+      // Return the board position with the given index value within the slice.
+      BoardType board(uint64_t index) const {
+         assert (index < size());
+
+         uint64_t player;
+         uint64_t opponent;
+         if (index < m_firstSize) {
+            RankType::unrankInClass(m_numMost, m_numLeast, index, player, opponent);
+         } else {
+            RankType::unrankInClass(m_numLeast, m_numMost, index - m_firstSize, player, opponent);
+         }
+
+         BoardType board;
+         board.setPosition(BoardType::makePosition(player, opponent));
+         return board;
+      } // board
+
+      // Return the name of the file holding the slice, e.g. "touchdown.tb.4-3".
+      std::string fileName(const std::string& baseName) const {
+         return baseName + "." + std::to_string(m_numMost) + "-" + std::to_string(m_numLeast);
+      }
+
+      bool operator==(const MaterialSlice& other) const {
+         return m_numMost == other.m_numMost && m_numLeast == other.m_numLeast;
+      }
+
+   private:
+      int      m_numMost;
+      int      m_numLeast;
+      uint64_t m_firstSize;
+      uint64_t m_secondSize;
+}; // MaterialSlice
+
+#endif // _TOUCHDOWN_SLICE_H
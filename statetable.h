@@ -0,0 +1,165 @@
+#ifndef _TOUCHDOWN_STATETABLE_H
+#define _TOUCHDOWN_STATETABLE_H
+
+#include <string.h>
+#include <assert.h>
+#include "tablebase.h"
+
+// The state of each position during the generation, in 2 bits per index
+// value:
+//    Unknown : The game value is not known yet.
+//    Loss    : The position is a LOSS.
+//    Win     : The position is a WIN, or it is illegal.
+//    Invalid : The index value does not stand for a position.
+// Looking up a successor is a single read, instead of one read of the
+// database and one of a table of known positions, which are on different
+// cache lines. The invalid index values are marked once, so they are
+// skipped without asking the index scheme again.
+//
+// Position pos is in bits 2*(pos%4) and up of byte pos/4. A state only
+// changes once, from Unknown to one of the others, which just sets bits. So
+// a state is set with a single atomic OR of its byte, like
+// TableBase::setBitAtomic, and concurrent writers can not lose each others
+// updates.
+//
+// The bits are held in a TableBase in memory, which can be checkpointed, and
+// the high bit of each state is the game value of the database.
+class StateTable
+{
+   public:
+      enum State {
+         Unknown = 0,
+         Loss    = 1,
+         Win     = 2,
+         Invalid = 3
+      };
+
+      // The table starts out with all positions Unknown. It is rounded up to
+      // whole 64-bit words, which is what forEachUnknown reads.
+      StateTable(ssize_t numPositions)
+         : m_numPositions(numPositions), m_table("", (numPositions + 31) / 32 * 64, TableBase::Memory)
+      {
+      }
+
+      State read(uint64_t pos) const {
+         return read(m_table.data(), pos);
+      }
+
+      void set(uint64_t pos, State state) {
+         set(m_table.data(), pos, state);
+      }
+
+      // The same, for states stored elsewhere, e.g. part of a file.
+      static State read(const uint8_t *states, uint64_t pos) {
+         return (State) ((states[pos/4] >> (2*(pos%4))) & 3);
+      }
+
+      static void set(uint8_t *states, uint64_t pos, State state) {
+         states[pos/4] |= state << (2*(pos%4));
+      }
+
+      // Thread safe versions of read and set, see TableBase::readBitAtomic.
+      State readAtomic(uint64_t pos) const {
+         return (State) ((__atomic_load_n(&m_table.data()[pos/4], __ATOMIC_ACQUIRE) >> (2*(pos%4))) & 3);
+      }
+
+      void setAtomic(uint64_t pos, State state) {
+         __atomic_fetch_or(&m_table.data()[pos/4], (uint8_t) (state << (2*(pos%4))), __ATOMIC_RELEASE);
+      }
+
+      void prefetch(uint64_t pos) const {
+         __builtin_prefetch(&m_table.data()[pos/4]);
+      }
+
+      // Call func(i) for each index value i in [begin, end) that is Unknown,
+      // in increasing order. The states are read 32 at a time, so the known
+      // and invalid positions cost next to nothing.
+      template <typename Func>
+      void forEachUnknown(uint64_t begin, uint64_t end, Func func) const {
+         forEachUnknown(m_table.data(), begin, end, func);
+      }
+
+      // The same, for states stored elsewhere. The states must be readable
+      // in whole, aligned 64-bit words.
+      template <typename Func>
+      static void forEachUnknown(const uint8_t *states, uint64_t begin, uint64_t end, Func func) {
+         const uint64_t *words = (const uint64_t *) states;
+         for (uint64_t w = begin / 32; w * 32 < end; ++w) {
+            uint64_t word = __atomic_load_n(&words[w], __ATOMIC_ACQUIRE);
+            uint64_t unknown = ~(word | (word >> 1)) & 0x5555555555555555;   // Low bit of each Unknown state.
+            while (unknown) {
+               uint64_t index = w * 32 + __builtin_ctzll(unknown) / 2;
+               unknown &= unknown - 1;
+               if (index >= begin && index < end) {
+                  func(index);
+               }
+            }
+         }
+      } // forEachUnknown
+
+      // Mark the invalid index values of the index scheme.
+      template <typename Index>
+      void fillInvalid() {
+         TableBase invalid("", m_numPositions, TableBase::Memory);
+         Index::fillInvalid(invalid);
+         const uint8_t *bits = invalid.data();
+         for (ssize_t i = 0; i < invalid.size(); ++i) {
+            if (bits[i]) {
+               uint16_t states = spread(bits[i]) * Invalid;
+               m_table.data()[2*i]   |= states & 0xFF;
+               m_table.data()[2*i+1] |= states >> 8;
+            }
+         }
+      } // fillInvalid
+
+      // Write the game values to tb, i.e. WIN for the Win and the Invalid
+      // states, and LOSS for the others.
+      void writeValues(TableBase& tb) const {
+         writeValues(m_table.data(), tb.data(), tb.size());
+      }
+
+      // Write numBytes bytes of game values, from the 2*numBytes bytes of
+      // states.
+      static void writeValues(const uint8_t *states, uint8_t *bits, size_t numBytes) {
+         for (size_t i = 0; i < numBytes; ++i) {
+            bits[i] = compact(((states[2*i] | (states[2*i+1] << 8)) >> 1) & 0x5555);
+         }
+      } // writeValues
+
+      // Reset all positions to Unknown.
+      void clear() {
+         m_table.clear();
+      }
+
+      // The underlying table, e.g. for checkpoints.
+      TableBase& table() {
+         return m_table;
+      }
+
+      const TableBase& table() const {
+         return m_table;
+      }
+
+   private:
+      // Move bit i of bits to bit 2*i, and back.
+      static uint16_t spread(uint8_t bits) {
+         uint16_t x = bits;
+         x = (x | (x << 4)) & 0x0F0F;
+         x = (x | (x << 2)) & 0x3333;
+         x = (x | (x << 1)) & 0x5555;
+         return x;
+      }
+
+      static uint8_t compact(uint16_t x) {
+         x = (x | (x >> 1)) & 0x3333;
+         x = (x | (x >> 2)) & 0x0F0F;
+         x = (x | (x >> 4)) & 0x00FF;
+         return x;
+      }
+
+      ssize_t   m_numPositions;
+      TableBase m_table;
+
+}; // StateTable
+
+#endif // _TOUCHDOWN_STATETABLE_H
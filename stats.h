@@ -0,0 +1,189 @@
+#ifndef _TOUCHDOWN_STATS_H
+#define _TOUCHDOWN_STATS_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <stdio.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "tablebase.h"
+
+// Statistics of the database generation, to tell whether a run is limited by
+// computation, memory, or I/O.
+//
+// The counters of the inner loops are only compiled in when TOUCHDOWN_STATS
+// is non-zero (the default). With e.g. -DTOUCHDOWN_STATS=0 in the Makefile,
+// they are empty, and cost nothing. The time and memory statistics are
+// always available, as they are only sampled once per pass.
+#ifndef TOUCHDOWN_STATS
+#define TOUCHDOWN_STATS 1
+#endif
+
+#if TOUCHDOWN_STATS
+class StatCounter
+{
+   public:
+      void add(uint64_t count = 1) { m_value += count; }
+      uint64_t value() const { return m_value; }
+
+      // Add the value of a counter of another thread.
+      void merge(const StatCounter& other) {
+         __atomic_fetch_add(&m_value, other.m_value, __ATOMIC_RELAXED);
+      }
+
+   private:
+      uint64_t m_value = 0;
+}; // StatCounter
+#else
+class StatCounter
+{
+   public:
+      void add(uint64_t = 1) {}
+      uint64_t value() const { return 0; }
+      void merge(const StatCounter&) {}
+}; // StatCounter
+#endif
+
+// The counters of one pass over the positions. Each thread counts in its own
+// copy, which is merged into the total at the end of each chunk.
+struct PassCounters
+{
+   StatCounter visited;        // Positions that were not yet known.
+   StatCounter resolvedWin;    // Positions that became known to be a WIN.
+   StatCounter resolvedLoss;   // Positions that became known to be a LOSS.
+   StatCounter probed;         // Successors looked up.
+   StatCounter exitUnknown;    // Move loops stopped by an unknown successor.
+   StatCounter exitWin;        // Move loops stopped by a successor that is a LOSS.
+
+   void merge(const PassCounters& other) {
+      visited.merge(other.visited);
+      resolvedWin.merge(other.resolvedWin);
+      resolvedLoss.merge(other.resolvedLoss);
+      probed.merge(other.probed);
+      exitUnknown.merge(other.exitUnknown);
+      exitWin.merge(other.exitWin);
+   }
+}; // PassCounters
+
+// Collects the statistics of each pass, and reports them as a line on
+// standard output, and optionally as a line of JSON in a log file.
+class PassStats
+{
+   public:
+      typedef std::chrono::steady_clock Clock;
+
+      // The tables are named in the report, e.g. "tb" and "known".
+      PassStats(const char *logFileName, const std::vector<std::pair<std::string, const TableBase*>>& tables)
+         : m_tables(tables), m_start(Clock::now()), m_passStart(m_start)
+      {
+         if (logFileName) {
+            m_log = fopen(logFileName, "w");
+            if (!m_log)
+            {
+               perror("fopen");
+            }
+         }
+         getrusage(RUSAGE_SELF, &m_usage);
+      }
+
+      ~PassStats()
+      {
+         if (m_log) {
+            fclose(m_log);
+         }
+      }
+
+      // Report a pass, and start the next one.
+      void report(int pass, const PassCounters& counters) {
+         Clock::time_point now = Clock::now();
+         double seconds = std::chrono::duration<double>(now - m_passStart).count();
+         double total   = std::chrono::duration<double>(now - m_start).count();
+         m_passStart = now;
+
+         struct rusage usage;
+         getrusage(RUSAGE_SELF, &usage);
+         long minorFaults = usage.ru_minflt - m_usage.ru_minflt;
+         long majorFaults = usage.ru_majflt - m_usage.ru_majflt;
+         double cpuSeconds = toSeconds(usage.ru_utime) + toSeconds(usage.ru_stime)
+                           - toSeconds(m_usage.ru_utime) - toSeconds(m_usage.ru_stime);
+         m_usage = usage;
+
+         uint64_t resolved = counters.resolvedWin.value() + counters.resolvedLoss.value();
+         uint64_t rate     = seconds > 0 ? counters.visited.value() / seconds : 0;
+
+         std::cout << "Pass " << std::setw(3) << pass << " : "
+                   << std::fixed << std::setprecision(2) << seconds << " s, "
+                   << (TOUCHDOWN_STATS ? std::to_string(counters.visited.value()) + " visited, "
+                                         + std::to_string(resolved) + " resolved, "
+                                         + std::to_string(rate) + " positions/s, " : "")
+                   << "cpu " << std::setprecision(0) << 100 * cpuSeconds / (seconds > 0 ? seconds : 1) << "%, "
+                   << "faults " << minorFaults << "/" << majorFaults << ", "
+                   << "rss " << (residentBytes() >> 20) << " MB";
+         for (const auto& table : m_tables) {
+            std::cout << ", " << table.first << " " << (table.second->residentBytes() >> 20) << " MB";
+         }
+         std::cout << std::endl;
+
+         if (!m_log) {
+            return;
+         }
+
+         std::ostringstream json;
+         json << std::setprecision(6)
+              << "{\"pass\": " << pass
+              << ", \"seconds\": " << seconds
+              << ", \"total_seconds\": " << total
+              << ", \"cpu_seconds\": " << cpuSeconds;
+         if (TOUCHDOWN_STATS) {
+            json << ", \"visited\": " << counters.visited.value()
+                 << ", \"resolved_win\": " << counters.resolvedWin.value()
+                 << ", \"resolved_loss\": " << counters.resolvedLoss.value()
+                 << ", \"probed\": " << counters.probed.value()
+                 << ", \"exit_unknown\": " << counters.exitUnknown.value()
+                 << ", \"exit_win\": " << counters.exitWin.value()
+                 << ", \"positions_per_second\": " << rate;
+         }
+         json << ", \"minor_faults\": " << minorFaults
+              << ", \"major_faults\": " << majorFaults
+              << ", \"max_rss_bytes\": " << (uint64_t) usage.ru_maxrss * 1024
+              << ", \"rss_bytes\": " << residentBytes();
+         for (const auto& table : m_tables) {
+            json << ", \"" << table.first << "_resident_bytes\": " << table.second->residentBytes();
+         }
+         json << "}\n";
+         fputs(json.str().c_str(), m_log);
+         fflush(m_log);
+      } // report
+
+      // Return the resident memory of the process.
+      static uint64_t residentBytes() {
+         uint64_t size     = 0;
+         uint64_t resident = 0;
+         FILE *file = fopen("/proc/self/statm", "r");
+         if (file) {
+            if (fscanf(file, "%lu %lu", &size, &resident) != 2) {
+               resident = 0;
+            }
+            fclose(file);
+         }
+         return resident * sysconf(_SC_PAGESIZE);
+      } // residentBytes
+
+   private:
+      static double toSeconds(const struct timeval& tv) {
+         return tv.tv_sec + tv.tv_usec * 1e-6;
+      }
+
+      std::vector<std::pair<std::string, const TableBase*>> m_tables;
+      Clock::time_point m_start;
+      Clock::time_point m_passStart;
+      struct rusage     m_usage;
+      FILE             *m_log = nullptr;
+
+}; // PassStats
+
+#endif // _TOUCHDOWN_STATS_H
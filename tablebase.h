@@ -2,12 +2,17 @@
 #define _TOUCHDOWN_TABLEBASE_H
 
 #include <string>
+#include <vector>
+#include <memory>
+#include <string.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <errno.h>
 #include <assert.h>
 
 const ssize_t g_numPositions = 1<<24;
@@ -15,48 +20,245 @@ const ssize_t g_numPositions = 1<<24;
 class TableBase
 {
    public:
+      enum Mode {
+         ReadWrite,  // Read from existing file or create new.
+         ReadOnly,   // Read from existing file. The table can not be modified.
+                     // The whole file is read into memory up front.
+         Memory      // Keep the table in memory only, starting out cleared.
+                     // It is written to the file (if any) by sync.
+      };
+
       // Default constructor clears the table.
-      TableBase(const std::string& fileName)
+      // The table holds numPositions bits, one for each index value.
+      //
+      // In the Memory mode, the table is not backed by the file, so setBit
+      // does not make the kernel write pages back to disk during the
+      // generation. The table uses explicit huge pages if the system has
+      // any reserved, and otherwise asks for transparent huge pages, to
+      // reduce the TLB misses of the random lookups. The fileName may be
+      // empty for scratch tables.
+      TableBase(const std::string& fileName, ssize_t numPositions = g_numPositions, Mode mode = ReadWrite)
+         : TableBase(numPositions, fileName)
       {
-         m_fd = open(fileName.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR); // Read from existing file or create new.
-         if (m_fd < 0)
-         {
-            perror("open");
-            assert (false);
+         if (mode == Memory) {
+            mapMemory();
+            return;
          }
 
-         if (posix_fallocate(m_fd, 0, g_numPositions/8)) // Make sure new file has the right size
+         std::string error = openFile(mode);
+         if (!error.empty())
          {
-            perror("fallocate");
-            assert (false);
-         }
-
-         m_table = (uint8_t *) mmap(nullptr, g_numPositions/8, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
-         if (m_table == MAP_FAILED) // Map the file to a pointer
-         {
-            perror("mmap");
+            fprintf(stderr, "%s: %s\n", fileName.c_str(), error.c_str());
             assert (false);
          }
       }
 
       ~TableBase()
       {
-         munmap(m_table, g_numPositions/8);
-         close(m_fd);
+         if (m_table != MAP_FAILED) {
+            munmap(m_table, m_mapSize);
+         }
+         if (m_fd >= 0) {
+            close(m_fd);
+         }
       }
 
-      int readBit(uint32_t pos) const {
+      // Open the existing file fileName like the ReadOnly mode, but return
+      // nullptr if it can not be opened or does not have the size of
+      // numPositions bits, instead of failing. This is for the library,
+      // which must not abort its host.
+      static std::unique_ptr<TableBase> tryOpen(const std::string& fileName, ssize_t numPositions) {
+         std::unique_ptr<TableBase> tb(new TableBase(numPositions, fileName));
+         if (!tb->openFile(ReadOnly).empty()) {
+            return nullptr;
+         }
+         return tb;
+      } // tryOpen
+
+      int readBit(uint64_t pos) const {
          return (m_table[pos/8] >> (pos%8)) & 1;
       }
 
-      void setBit(uint32_t pos, int val) {
+      // The same as readBit, which can not fail for a TableBase. See
+      // CompressedTableBase::tryReadBit.
+      int tryReadBit(uint64_t pos) const {
+         return readBit(pos);
+      }
+
+      void setBit(uint64_t pos, int val) {
          if (val)
             m_table[pos/8] |= (1 << (pos%8));
       }
 
+      // Thread safe versions of readBit and setBit. A bit is set with a
+      // single atomic read-modify-write of the byte, so concurrent writers can
+      // not lose each others updates. A reader that sees a bit set by another
+      // thread also sees everything that thread wrote before setting it.
+      int readBitAtomic(uint64_t pos) const {
+         return (__atomic_load_n(&m_table[pos/8], __ATOMIC_ACQUIRE) >> (pos%8)) & 1;
+      }
+
+      void setBitAtomic(uint64_t pos, int val) {
+         if (val)
+            __atomic_fetch_or(&m_table[pos/8], (uint8_t) (1 << (pos%8)), __ATOMIC_RELEASE);
+      }
+
+      // Start loading the byte holding a position into the cache, so a later
+      // readBit does not have to wait for it.
+      void prefetch(uint64_t pos) const {
+         __builtin_prefetch(&m_table[pos/8]);
+      }
+
+      // Return the raw table, with the value of position pos in bit pos%8 of
+      // byte pos/8.
+      const uint8_t *data() const {
+         return m_table;
+      }
+
+      uint8_t *data() {
+         return m_table;
+      }
+
+      // Return the size of the table in bytes.
+      ssize_t size() const {
+         return m_size;
+      }
+
+      // Return the number of bytes of the table, that are currently in memory.
+      uint64_t residentBytes() const {
+         long pageSize = sysconf(_SC_PAGESIZE);
+         std::vector<unsigned char> pages((m_size + pageSize - 1) / pageSize);
+         if (mincore(m_table, m_size, pages.data()))
+            return 0;
+         uint64_t count = 0;
+         for (unsigned char page : pages) {
+            count += page & 1;
+         }
+         return count * pageSize;
+      } // residentBytes
+
+      // Write the changes of the table to the file, and wait until they are
+      // on disk. In the Memory mode, the whole table is written to the file.
+      void sync() {
+         if (m_fd >= 0) {
+            if (msync(m_table, m_size, MS_SYNC))
+            {
+               perror("msync");
+               assert (false);
+            }
+            return;
+         }
+         if (m_fileName.empty()) {
+            return;
+         }
+
+         int fd = open(m_fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+         if (fd < 0)
+         {
+            perror("open");
+            assert (false);
+         }
+         for (ssize_t done = 0; done < m_size; ) {
+            ssize_t count = write(fd, m_table + done, m_size - done);
+            if (count <= 0)
+            {
+               perror("write");
+               assert (false);
+            }
+            done += count;
+         }
+         if (fsync(fd) || close(fd))
+         {
+            perror("fsync");
+            assert (false);
+         }
+      } // sync
+
+      // Return true if the table is in explicit huge pages.
+      bool hasHugePages() const {
+         return m_mapSize != (size_t) m_size;
+      }
+
+      // Reset all positions to the game value LOSS.
+      void clear() {
+         memset(m_table, 0, m_size);
+      }
+
    private:
-      uint8_t *m_table;
-      int      m_fd;
+      static const size_t cHugePageSize = 2 << 20;
+
+      // Construct a table without any memory, that is then opened by
+      // openFile or mapMemory.
+      TableBase(ssize_t numPositions, const std::string& fileName)
+         : m_table((uint8_t *) MAP_FAILED), m_size((numPositions + 7) / 8), m_mapSize(m_size), m_fd(-1), m_fileName(fileName)
+      {
+      }
+
+      // Open and map the file in the ReadOnly or ReadWrite mode. Returns an
+      // error message, or an empty string if the table was opened.
+      std::string openFile(Mode mode) {
+         if (mode == ReadOnly) {
+            m_fd = open(m_fileName.c_str(), O_RDONLY);
+         } else {
+            m_fd = open(m_fileName.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+         }
+         if (m_fd < 0) {
+            return std::string("open: ") + strerror(errno);
+         }
+
+         if (mode == ReadOnly) {
+            // Make sure existing file has the right size. A raw table has no
+            // header, so this is what rejects e.g. a database of another
+            // index scheme.
+            struct stat st;
+            if (fstat(m_fd, &st)) {
+               return std::string("fstat: ") + strerror(errno);
+            }
+            if (st.st_size != m_size) {
+               return "File has " + std::to_string(st.st_size) + " bytes, expected " + std::to_string(m_size);
+            }
+         } else if (int error = posix_fallocate(m_fd, 0, m_size)) { // Make sure new file has the right size
+            return std::string("fallocate: ") + strerror(error);
+         }
+
+         int prot  = (mode == ReadOnly) ? PROT_READ : PROT_READ | PROT_WRITE;
+         int flags = (mode == ReadOnly) ? MAP_SHARED | MAP_POPULATE : MAP_SHARED;
+         m_table = (uint8_t *) mmap(nullptr, m_size, prot, flags, m_fd, 0);
+         if (m_table == MAP_FAILED) { // Map the file to a pointer
+            return std::string("mmap: ") + strerror(errno);
+         }
+         if (mode == ReadOnly) {
+            madvise(m_table, m_size, MADV_WILLNEED);  // The lookups are random, so keep everything.
+         }
+         return "";
+      } // openFile
+
+      void mapMemory() {
+         // Explicit huge pages need the size to be a multiple of the page size.
+         if (m_size >= (ssize_t) cHugePageSize) {
+            size_t hugeSize = (m_size + cHugePageSize - 1) / cHugePageSize * cHugePageSize;
+            m_table = (uint8_t *) mmap(nullptr, hugeSize, PROT_READ | PROT_WRITE,
+                                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (m_table != MAP_FAILED) {
+               m_mapSize = hugeSize;
+               return;
+            }
+         }
+
+         m_table = (uint8_t *) mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+         if (m_table == MAP_FAILED)
+         {
+            perror("mmap");
+            assert (false);
+         }
+         madvise(m_table, m_size, MADV_HUGEPAGE);
+      } // mapMemory
+
+      uint8_t    *m_table;
+      ssize_t     m_size;      // Size of table in bytes.
+      size_t      m_mapSize;   // Size of the mapping, rounded up to whole huge pages.
+      int         m_fd;        // The file, if it is mapped.
+      std::string m_fileName;
 
 }; // TableBase
 
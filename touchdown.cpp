@@ -0,0 +1,274 @@
+#include <memory>
+#include "touchdown.h"
+#include "board.h"
+#include "indexing.h"
+#include "tablebase.h"
+#include "compressed.h"
+
+// The implementation of the C interface of libtouchdown.so, see touchdown.h.
+
+// Initialize the index tables when the library is loaded.
+static struct LibraryInit
+{
+   LibraryInit() {
+      indexInit();
+   }
+} s_libraryInit;
+
+// A database of any board size and index scheme.
+class Database
+{
+   public:
+      virtual ~Database() {}
+      virtual uint64_t numPositions() const = 0;
+      // The probes return false if a block of a compressed database is
+      // damaged, see CompressedTableBase::tryReadBit.
+      virtual bool probeBoards(const uint64_t *player, const uint64_t *opponent, size_t count, int8_t *results) const = 0;
+      virtual bool probeIndices(const uint64_t *indices, size_t count, int8_t *results) const = 0;
+      virtual void toIndices(const uint64_t *player, const uint64_t *opponent, size_t count, uint64_t *indices) const = 0;
+}; // Database
+
+struct td_db
+{
+   std::unique_ptr<Database> database;
+}; // td_db
+
+// Construct a board from two bitboards. Returns false if the board can not
+// occur in a game.
+template <typename BoardType>
+static bool makeBoard(uint64_t player, uint64_t opponent, BoardType& board)
+{
+   if ((player & opponent) || ((player | opponent) & ~BoardType::cAllSquares) ||
+       __builtin_popcountll(player) > BoardType::cNumPawns || __builtin_popcountll(opponent) > BoardType::cNumPawns) {
+      return false;
+   }
+   board.setPosition(BoardType::makePosition(player, opponent));
+   return !board.isWin();
+} // makeBoard
+
+template <typename Index, typename Table>
+class DatabaseImpl : public Database
+{
+   public:
+      typedef typename Index::BoardType BoardType;
+
+      DatabaseImpl(std::unique_ptr<Table> tb) : m_tb(std::move(tb))
+      {
+      }
+
+      uint64_t numPositions() const {
+         return Index::size();
+      }
+
+      // The boards are converted and prefetched in blocks, and then looked up.
+      bool probeBoards(const uint64_t *player, const uint64_t *opponent, size_t count, int8_t *results) const {
+         uint64_t indices[cBlockSize];
+         bool ok = true;
+         for (size_t begin = 0; begin < count; begin += cBlockSize) {
+            size_t size = std::min(cBlockSize, count - begin);
+            toIndices(player + begin, opponent + begin, size, indices);
+            ok &= lookup(indices, size, results + begin);
+         }
+         return ok;
+      } // probeBoards
+
+      bool probeIndices(const uint64_t *indices, size_t count, int8_t *results) const {
+         uint64_t checked[cBlockSize];
+         bool ok = true;
+         for (size_t begin = 0; begin < count; begin += cBlockSize) {
+            size_t size = std::min(cBlockSize, count - begin);
+            for (size_t i = 0; i < size; ++i) {
+               uint64_t index = indices[begin + i];
+               bool legal = index < Index::size() && Index::isValid(index) && !Index::board(index).isWin();
+               checked[i] = legal ? index : cIllegal;
+               if (legal) {
+                  m_tb->prefetch(index);
+               }
+            }
+            ok &= lookup(checked, size, results + begin);
+         }
+         return ok;
+      } // probeIndices
+
+      void toIndices(const uint64_t *player, const uint64_t *opponent, size_t count, uint64_t *indices) const {
+         for (size_t i = 0; i < count; ++i) {
+            BoardType board;
+            if (makeBoard(player[i], opponent[i], board)) {
+               indices[i] = Index::index(board);
+               m_tb->prefetch(indices[i]);
+            } else {
+               indices[i] = cIllegal;
+            }
+         }
+      } // toIndices
+
+   private:
+      static const size_t   cBlockSize = 64;
+      static const uint64_t cIllegal   = UINT64_MAX;
+
+      // Returns false if a value is in a damaged block, and is given as
+      // TD_DAMAGED.
+      bool lookup(const uint64_t *indices, size_t count, int8_t *results) const {
+         bool ok = true;
+         for (size_t i = 0; i < count; ++i) {
+            if (indices[i] == cIllegal) {
+               results[i] = TD_ILLEGAL;
+               continue;
+            }
+            int value = m_tb->tryReadBit(indices[i]);
+            results[i] = (value < 0) ? TD_DAMAGED : value ? TD_WIN : TD_LOSS;
+            ok &= value >= 0;
+         }
+         return ok;
+      } // lookup
+
+      std::unique_ptr<Table> m_tb;
+}; // DatabaseImpl
+
+// Open a database of the table type Table. Returns nullptr if the file can
+// not be opened, or does not fit the index scheme, as td_open must not abort
+// the host.
+template <typename Index, typename Table>
+static Database *openTable(const char *fileName)
+{
+   std::unique_ptr<Table> tb = Table::tryOpen(fileName, Index::size());
+   return tb ? new DatabaseImpl<Index, Table>(std::move(tb)) : nullptr;
+} // openTable
+
+// Open a plain or compressed database.
+template <typename Index>
+static Database *openDatabase(const char *fileName)
+{
+   if (CompressedTableBase::isCompressed(fileName)) {
+      return openTable<Index, CompressedTable<Index>>(fileName);
+   }
+   return openTable<Index, TableBase>(fileName);
+} // openDatabase
+
+template <int tNumRows, int tNumCols>
+static Database *openRankDatabase(const char *fileName, int scheme)
+{
+   switch (scheme)
+   {
+      case TD_INDEX_RANK   : return openDatabase<RankIndex<tNumRows, tNumCols>>(fileName);
+      case TD_INDEX_MIRROR : return openDatabase<MirrorIndex<tNumRows, tNumCols>>(fileName);
+   }
+   return nullptr;
+} // openRankDatabase
+
+template <typename BoardType>
+static void legalMoves(const uint64_t *player, const uint64_t *opponent, size_t count,
+                       uint64_t *movePlayer, uint64_t *moveOpponent, int32_t *moveCounts)
+{
+   for (size_t i = 0; i < count; ++i) {
+      BoardType board;
+      if (!makeBoard(player[i], opponent[i], board)) {
+         moveCounts[i] = TD_ILLEGAL;
+         continue;
+      }
+
+      typename BoardType::Position legalMoves[BoardType::cMaxMoves];
+      int moveCount = board.isLoss() ? 0 : board.writeLegalMoves(legalMoves);
+      for (int j = 0; j < moveCount; ++j) {
+         board.setPosition(legalMoves[j]);
+         movePlayer[i * BoardType::cMaxMoves + j]   = board.getPlayer();
+         moveOpponent[i * BoardType::cMaxMoves + j] = board.getOpponent();
+      }
+      moveCounts[i] = moveCount;
+   }
+} // legalMoves
+
+extern "C" {
+
+int td_api_version(void)
+{
+   return TD_API_VERSION;
+}
+
+td_db *td_open(const char *file_name, int num_rows, int num_cols, int scheme)
+{
+   if (!file_name) {
+      return nullptr;
+   }
+
+   Database *database = nullptr;
+   if (num_rows == 4 && num_cols == 4) {
+      database = (scheme == TD_INDEX_SPARSE) ? openDatabase<SparseIndex<4, 4>>(file_name)
+                                             : openRankDatabase<4, 4>(file_name, scheme);
+   } else if (num_rows == 4 && num_cols == 6) {
+      database = openRankDatabase<4, 6>(file_name, scheme);
+   } else if (num_rows == 6 && num_cols == 8) {
+      database = openRankDatabase<6, 8>(file_name, scheme);
+   }
+   if (!database) {
+      return nullptr;
+   }
+
+   td_db *db = new td_db;
+   db->database.reset(database);
+   return db;
+} // td_open
+
+void td_close(td_db *db)
+{
+   delete db;
+}
+
+uint64_t td_num_positions(const td_db *db)
+{
+   return db ? db->database->numPositions() : 0;
+}
+
+int td_probe_boards(const td_db *db, const uint64_t *player, const uint64_t *opponent,
+                    size_t count, int8_t *results)
+{
+   if (!db || (count && (!player || !opponent || !results))) {
+      return TD_ERROR;
+   }
+   return db->database->probeBoards(player, opponent, count, results) ? TD_OK : TD_DAMAGED;
+} // td_probe_boards
+
+int td_probe_indices(const td_db *db, const uint64_t *indices, size_t count, int8_t *results)
+{
+   if (!db || (count && (!indices || !results))) {
+      return TD_ERROR;
+   }
+   return db->database->probeIndices(indices, count, results) ? TD_OK : TD_DAMAGED;
+} // td_probe_indices
+
+int td_boards_to_indices(const td_db *db, const uint64_t *player, const uint64_t *opponent,
+                         size_t count, uint64_t *indices)
+{
+   if (!db || (count && (!player || !opponent || !indices))) {
+      return TD_ERROR;
+   }
+   db->database->toIndices(player, opponent, count, indices);
+   return TD_OK;
+} // td_boards_to_indices
+
+int td_max_moves(int num_rows, int num_cols)
+{
+   if ((num_rows == 4 && (num_cols == 4 || num_cols == 6)) || (num_rows == 6 && num_cols == 8)) {
+      return 3 * num_cols;
+   }
+   return 0;
+} // td_max_moves
+
+int td_legal_moves(int num_rows, int num_cols, const uint64_t *player, const uint64_t *opponent,
+                   size_t count, uint64_t *move_player, uint64_t *move_opponent, int32_t *move_counts)
+{
+   if (!td_max_moves(num_rows, num_cols) || (count && (!player || !opponent || !move_player || !move_opponent || !move_counts))) {
+      return TD_ERROR;
+   }
+
+   if (num_cols == 4) {
+      legalMoves<Board<4, 4>>(player, opponent, count, move_player, move_opponent, move_counts);
+   } else if (num_cols == 6) {
+      legalMoves<Board<4, 6>>(player, opponent, count, move_player, move_opponent, move_counts);
+   } else {
+      legalMoves<Board<6, 8>>(player, opponent, count, move_player, move_opponent, move_counts);
+   }
+   return TD_OK;
+} // td_legal_moves
+
+} // extern "C"
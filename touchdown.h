@@ -0,0 +1,111 @@
+#ifndef _TOUCHDOWN_H
+#define _TOUCHDOWN_H
+
+/*
+ * The C interface of libtouchdown.so, for using the databases from other
+ * programs, e.g. from Python through ctypes and numpy.
+ *
+ * A board is given as two bitboards, of the pawns of the player to move and
+ * of the opponent. Bit i is square i, counted row by row from the opponents
+ * back rank, which the player moves towards. E.g. on the 4x4 board:
+ *     0  1  2  3     <- The player wins by moving a pawn here.
+ *     4  5  6  7
+ *     8  9 10 11
+ *    12 13 14 15
+ * All functions work on arrays of count boards, and write their results to
+ * arrays provided by the caller. They allocate no memory, and only fail for
+ * bad arguments, returning TD_ERROR, or for a damaged compressed database,
+ * returning TD_DAMAGED. A board that can not occur in a game (e.g. with
+ * overlapping pawns, too many pawns, or a player pawn on the opponents back
+ * rank) is not an error, but gives the result TD_ILLEGAL.
+ *
+ * The functions may be called from several threads at the same time, also
+ * with the same database.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TD_API_VERSION 1
+
+/* Only the functions below are exported by the library. */
+#define TD_EXPORT __attribute__((visibility("default")))
+
+/* The index schemes, see indexing.h. */
+#define TD_INDEX_SPARSE 0    /* The 24-bit index, only for the 4x4 board. */
+#define TD_INDEX_RANK   1    /* The dense rank index (-x). */
+#define TD_INDEX_MIRROR 2    /* The rank index reduced by mirror symmetry (-y). */
+
+/* Results. */
+#define TD_LOSS     0
+#define TD_WIN      1
+#define TD_ILLEGAL  (-1)
+#define TD_DAMAGED  (-2)     /* Both a result and a return value, see td_probe_boards. */
+#define TD_OK       0
+#define TD_ERROR    (-1)
+
+typedef struct td_db td_db;
+
+/* Return TD_API_VERSION of the library. */
+TD_EXPORT int td_api_version(void);
+
+/*
+ * Open a database read-only, e.g. td_open("touchdown.tb", 4, 4,
+ * TD_INDEX_SPARSE). The board sizes are 4x4, 6x4 and 8x6, i.e. num_cols is
+ * 4, 6 or 8, and num_rows 4, 4 or 6. Compressed databases (-k) are accepted
+ * too. Returns NULL if the board size or index scheme is not supported, or
+ * if the file is missing or does not fit them, i.e. a database has another
+ * size, or a compressed database was written for another scheme.
+ */
+TD_EXPORT td_db *td_open(const char *file_name, int num_rows, int num_cols, int scheme);
+TD_EXPORT void td_close(td_db *db);
+
+/* Return the number of index values of the database. */
+TD_EXPORT uint64_t td_num_positions(const td_db *db);
+
+/*
+ * Look up count boards. results[i] is TD_WIN, TD_LOSS or TD_ILLEGAL.
+ * The lookups of a batch are prefetched together, so large batches are
+ * faster than single lookups. If a value is in a damaged block of a
+ * compressed database, its result is TD_DAMAGED, the other results are
+ * still valid, and the function returns TD_DAMAGED.
+ */
+TD_EXPORT int td_probe_boards(const td_db *db, const uint64_t *player, const uint64_t *opponent,
+                              size_t count, int8_t *results);
+
+/*
+ * Look up count index values, as written by touchdown_db -c and -d.
+ * results[i] is TD_WIN, TD_LOSS or TD_ILLEGAL, or TD_DAMAGED as for
+ * td_probe_boards.
+ */
+TD_EXPORT int td_probe_indices(const td_db *db, const uint64_t *indices, size_t count, int8_t *results);
+
+/*
+ * Convert count boards to index values of the database. The index value of
+ * an illegal board is UINT64_MAX.
+ */
+TD_EXPORT int td_boards_to_indices(const td_db *db, const uint64_t *player, const uint64_t *opponent,
+                                   size_t count, uint64_t *indices);
+
+/* Return the maximum number of legal moves of a position, or 0 for an unsupported board size. */
+TD_EXPORT int td_max_moves(int num_rows, int num_cols);
+
+/*
+ * Generate the legal moves of count boards. The positions after the moves of
+ * board i are written to move_player and move_opponent, from index
+ * i*td_max_moves(num_rows, num_cols), seen from the opponents side, i.e.
+ * ready to be probed. move_counts[i] is the number of moves, which is 0 if
+ * the game is over, or TD_ILLEGAL for an illegal board.
+ */
+TD_EXPORT int td_legal_moves(int num_rows, int num_cols, const uint64_t *player, const uint64_t *opponent,
+                             size_t count, uint64_t *move_player, uint64_t *move_opponent, int32_t *move_counts);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TOUCHDOWN_H */
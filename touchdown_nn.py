@@ -20,7 +20,7 @@ batch_size = 512
 hidden1 = 256
 hidden2 = 128
 
-import gzip
+import os
 import numpy as np
 import tensorflow as tf
 
@@ -33,11 +33,20 @@ from tensorflow.python.keras.layers import Conv2D, Dense, Flatten
 input_width = 32    # Number of input features
 output_width = 2    # Number of output classes
 
-with gzip.open("touchdown.txt.gz", 'rb') as f:
-    input_data = np.loadtxt(f, usecols=range(input_width))
+# The data set is exported by "touchdown_db -e touchdown.tb", optionally with
+# "-z seed" to shuffle it and "-p percent" to split off a validation set.
+# The features are packed 8 per byte, and the labels are 1 for a win.
+def load_data(name):
+    features = np.unpackbits(np.load(name + ".x.npy"), axis=1, bitorder='little')
+    labels = np.load(name + ".y.npy")
+    return (features[:, :input_width].astype(np.float32),
+            np.stack([labels, 1 - labels], axis=1).astype(np.float32))
 
-with gzip.open("touchdown.txt.gz", 'rb') as f:
-    output_data = np.loadtxt(f, usecols=range(input_width, input_width + output_width))
+input_data, output_data = load_data("touchdown.tb.train")
+
+validation_data = None
+if os.path.exists("touchdown.tb.valid.x.npy"):
+    validation_data = load_data("touchdown.tb.valid")
 
 
 print("Total data available:")
@@ -87,6 +96,7 @@ model.summary()
 
 model.fit(x=input_data,
           y=output_data,
+          validation_data=validation_data,
           epochs=epochs, batch_size=batch_size)
 
 